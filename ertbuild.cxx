@@ -1,4 +1,5 @@
-﻿#include "ertcom.h"
+﻿#include "ertrsrc.h"
+#include "ui/uicc/uicom.h"
 
 struct {
 	Array<string> files_include = Array<string>(0x10);
@@ -9,6 +10,12 @@ struct {
 	bool alpha;
 	uint major, minor;
 } runtime_ver_state;
+struct {
+	bool initialized = false;
+	UI::Markup::CompilerOptions options;
+	SafePointer<UI::Markup::ICompilationCache> cache;
+	ObjectArray<UI::Markup::CompilationTask> tasks = ObjectArray<UI::Markup::CompilationTask>(0x40);
+} uiml_state;
 
 #define ERTBT_SCRIPT_COMMAND_MKDIR	L"mkdir"
 #define ERTBT_SCRIPT_COMMAND_MV		L"mv"
@@ -301,6 +308,15 @@ int HandleProcessDirectives(const string & source, const string & object, const
 	}
 	return ERTBT_SUCCESS;
 }
+int CompileInterfaces(Console & console)
+{
+	if (!uiml_state.tasks.Length()) return ERTBT_SUCCESS;
+	SafePointer<ThreadPool> pool;
+	try { pool = new ThreadPool; } catch (...) {}
+	auto error = UI::Markup::RunCompilationTasks(uiml_state.tasks, console, pool);
+	uiml_state.tasks.Clear();
+	return error ? ERTBT_COMPILATION_FAILED : ERTBT_SUCCESS;
+}
 int CompileSource(const string & source, const string & object, const string & log, Console & console, Array<string> * insert_build, Array<string> * insert_link, bool use_lang_ext)
 {
 	Array<string> command_line_ex(0x10);
@@ -329,7 +345,8 @@ int CompileSource(const string & source, const string & object, const string & l
 		auto error = HandleProcessDirectives(source, object, lang_ext_command, command_line_ex, console);
 		if (error) return error;
 	}
-	if (!state.clean && object.Length()) {
+	bool is_uiml = string::CompareIgnoreCase(IO::Path::GetExtension(source), ERTBT_SOURCE_FILE_UIML) == 0;
+	if (!state.clean && object.Length() && !is_uiml) {
 		try {
 			FileStream src(source, AccessRead, OpenExisting);
 			FileStream out(object, AccessRead, OpenExisting);
@@ -343,20 +360,22 @@ int CompileSource(const string & source, const string & object, const string & l
 			}
 		} catch (...) {}
 	}
-	if (string::CompareIgnoreCase(IO::Path::GetExtension(source), ERTBT_SOURCE_FILE_UIML) == 0) {
-		Array<string> command_line(0x10);
-		command_line << source;
-		if (state.silent) command_line << L"-S";
-		command_line << L"-o";
-		command_line << object;
-		command_line << command_line_ex;
-		SafePointer<Process> uicc = CreateCommandProcess(L"uicc", &command_line);
-		if (!uicc) {
-			if (!state.silent) console << TextColor(ConsoleColor::Red) << L"Failed to launch UICC." << TextColorDefault() << LineFeed();
-			return ERTBT_INVALID_COMPILER_SET;
+	if (is_uiml) {
+		if (!uiml_state.initialized) {
+			UI::Markup::LoadCompilerConfiguration(uiml_state.options);
+			if (!uiml_state.options.token_cache.Length()) uiml_state.options.token_cache = GetToolCachePath() + L"/tokens";
+			uiml_state.cache = UI::Markup::CreateCompilationCache(uiml_state.options.token_cache);
+			uiml_state.initialized = true;
 		}
-		uicc->Wait();
-		if (uicc->GetExitCode()) return ERTBT_COMPILATION_FAILED;
+		UI::Markup::CompilerOptions options = uiml_state.options;
+		options.silent = state.silent;
+		options.output_file = object;
+		if (!UI::Markup::ParseCompilerArguments(command_line_ex, 0, options, 0, 0, console)) return ERTBT_EXTENSIONS_SYNTAX;
+		options.dependency_manifest = true;
+		if (state.project->GetValueBoolean(L"SpecializeInterfaces") && !options.specialize_system.Length()) options.specialize_system = state.os.Name;
+		if (!state.clean && UI::Markup::CheckDependencyManifest(object, options)) return ERTBT_SUCCESS;
+		SafePointer<UI::Markup::CompilationTask> task = new UI::Markup::CompilationTask(options, source, object, uiml_state.cache);
+		uiml_state.tasks.Append(task);
 		return ERTBT_SUCCESS;
 	} else if (string::CompareIgnoreCase(IO::Path::GetExtension(source), ERTBT_SOURCE_FILE_EGSL) == 0) {
 		Array<string> command_line(0x10);
@@ -374,6 +393,8 @@ int CompileSource(const string & source, const string & object, const string & l
 		if (slt->GetExitCode()) return ERTBT_COMPILATION_FAILED;
 		return ERTBT_SUCCESS;
 	} else if (string::CompareIgnoreCase(IO::Path::GetExtension(source), ERTBT_SOURCE_FILE_SCRIPT) == 0) {
+		auto error = CompileInterfaces(console);
+		if (error) return error;
 		Array<string> alerts(0x40);
 		if (!state.silent) console << L"Executing " << TextColor(ConsoleColor::Cyan) << IO::Path::GetFileName(source) << TextColorDefault() << L"...";
 		try {
@@ -603,11 +624,31 @@ int InvokeResourceTool(Console & console, Array<string> & link_list)
 		auto rt = res_node->GetValueString(L"Path");
 		auto link_with = res_node->GetValueString(L"SetLink");
 		auto set_output = res_node->GetValueString(L"SetOutput");
-		if (!rt.Length()) {
+		auto in_process = res_node->GetValueBoolean(L"Windows") || res_node->GetValueBoolean(L"MacOSX") || res_node->GetValueBoolean(L"Linux");
+		if (!rt.Length() && !in_process) {
 			SkipResourceToolAlert(console);
 			return ERTBT_SUCCESS;
 		}
-		if (!state.pathout) {
+		if (!state.pathout && in_process) {
+			for (int i = 0; i < lang_ext_state.include_as.Length(); i++) if (lang_ext_state.include_as[i] == 0) {
+				auto error = RegisterResource(lang_ext_state.include_with_name[i], lang_ext_state.files_include[i], console);
+				if (error) return error;
+			}
+			try {
+				auto error = GenerateResources(console);
+				if (error) {
+					IO::SetStandardOutput(state.stdout_clone);
+					IO::SetStandardError(state.stderr_clone);
+					if (!state.silent) console << TextColor(ConsoleColor::Red) << L"Resource generator failed." << TextColorDefault() << LineFeed();
+					return error;
+				}
+			} catch (...) {
+				IO::SetStandardOutput(state.stdout_clone);
+				IO::SetStandardError(state.stderr_clone);
+				if (!state.silent) console << TextColor(ConsoleColor::Red) << L"Resource generator failed." << TextColorDefault() << LineFeed();
+				return ERTBT_COMMON_EXCEPTION;
+			}
+		} else if (!state.pathout) {
 			Array<string> rt_args(0x10);
 			rt_args << state.project_file_path;
 			rt_args << L"-N";
@@ -745,6 +786,8 @@ int BuildRuntime(Console & console)
 		auto error = CompileSource(f, fo, fl, console, &compile_list, 0, false);
 		if (error) return error;
 	}
+	auto error = CompileInterfaces(console);
+	if (error) return error;
 	auto end = GetTimerValue();
 	if (!state.silent) console << TextColor(ConsoleColor::Green) << FormatString(L"Runtime build have completed successfully, %0 ms spent.", end - start) << TextColorDefault() << LineFeed();
 	return ERTBT_SUCCESS;
@@ -798,6 +841,8 @@ int BuildProject(Console & console)
 			if (error) return error;
 			if (add_output_to_linkage) object_files << fo;
 		}
+		auto error = CompileInterfaces(console);
+		if (error) return error;
 	}
 	if (!state.pathout) {
 		auto wd = IO::GetCurrentDirectory();
@@ -857,6 +902,7 @@ void PrintTargetsInformation(Console & console)
 
 int Main(void)
 {
+	Codec::InitializeDefaultCodecs();
 	state.stdout_clone = IO::CloneHandle(IO::GetStandardOutput());
 	state.stderr_clone = IO::CloneHandle(IO::GetStandardError());
 	Console console(state.stdout_clone);
@@ -1,5 +1,14 @@
 ﻿#include "ertcom.h"
 
+#ifdef ENGINE_MACOSX
+#include <sys/clonefile.h>
+#endif
+#ifdef ENGINE_UNIX
+#include <unistd.h>
+#else
+#include <process.h>
+#endif
+
 BuilderState state;
 
 SafePointer<Registry> tool_config;
@@ -122,17 +131,72 @@ bool CopyFile(const string & from, const string & to)
 	} catch (...) { return false; }
 	return true;
 }
+bool LinkFile(const string & from, const string & to)
+{
+	try { IO::RemoveFile(to); } catch (...) {}
+	#ifdef ENGINE_UNIX
+	try {
+		SafePointer<DataBlock> source = IO::ExpandPath(from).EncodeSequence(Encoding::UTF8, true);
+		SafePointer<DataBlock> dest = IO::ExpandPath(to).EncodeSequence(Encoding::UTF8, true);
+		#ifdef ENGINE_MACOSX
+		if (clonefile(reinterpret_cast<char *>(source->GetBuffer()), reinterpret_cast<char *>(dest->GetBuffer()), 0) == 0) return true;
+		#else
+		if (link(reinterpret_cast<char *>(source->GetBuffer()), reinterpret_cast<char *>(dest->GetBuffer())) == 0) return true;
+		#endif
+	} catch (...) {}
+	#endif
+	return CopyFile(from, to);
+}
+string MakeTemporaryPath(const string & path)
+{
+	// The process and a counter tell apart the writers of parallel builds and the threads of one build.
+	static uint counter = 0;
+	#ifdef ENGINE_UNIX
+	uint process = uint(getpid());
+	#else
+	uint process = uint(_getpid());
+	#endif
+	return path + L"." + string(process) + L"-" + string(InterlockedIncrement(counter)) + L".tmp";
+}
+bool CommitTemporaryFile(const string & temp, const string & path)
+{
+	try {
+		#ifndef ENGINE_UNIX
+		try { IO::RemoveFile(path); } catch (...) {}
+		#endif
+		IO::MoveFile(temp, path);
+	} catch (...) {
+		try { IO::RemoveFile(temp); } catch (...) {}
+		return false;
+	}
+	return true;
+}
+bool IsFileUpToDate(const string & source, const string & dest)
+{
+	try {
+		FileStream src(source, AccessRead, OpenExisting);
+		FileStream out(dest, AccessRead, OpenExisting);
+		if (src.Length() != out.Length()) return false;
+		return IO::DateTime::GetFileAlterTime(out.Handle()) >= IO::DateTime::GetFileAlterTime(src.Handle());
+	} catch (...) { return false; }
+}
 
 int ConfigurationInitialize(Console & console)
 {
 	auto config_file_pref = IO::Path::GetDirectory(IO::GetExecutablePath()) + L"/ertbuild.";
 	try {
 		FileStream config_file_stream(config_file_pref + L"ecs", AccessRead, OpenExisting);
+		SafePointer<DataBlock> config_data = config_file_stream.ReadAll();
+		state.config_digest = FormatDigest(ComputeDigest(config_data->GetBuffer(), config_data->Length()));
+		config_file_stream.Seek(0, Begin);
 		tool_config = LoadRegistry(&config_file_stream);
 		if (!tool_config) throw Exception();
 	} catch (...) {
 		try {
 			FileStream config_file_stream(config_file_pref + L"ini", AccessRead, OpenExisting);
+			SafePointer<DataBlock> config_data = config_file_stream.ReadAll();
+			state.config_digest = FormatDigest(ComputeDigest(config_data->GetBuffer(), config_data->Length()));
+			config_file_stream.Seek(0, Begin);
 			tool_config = CompileTextRegistry(&config_file_stream);
 			if (!tool_config) throw Exception();
 		} catch (...) {
@@ -235,7 +299,13 @@ BuildTarget * FindTarget(const string & name, BuildTargetClass cls)
 	for (auto & e : *search_vol) if (string::CompareIgnoreCase(e.Name, name) == 0) { return &e; }
 	return 0;
 }
-int MakeLocalConfiguration(Console & console)
+string GetToolCachePath(void) { return IO::Path::GetDirectory(IO::GetExecutablePath()) + L"/_cache"; }
+string GetProjectCachePath(void) { return IO::ExpandPath(state.project_root_path + L"/_build/_cache"); }
+string GetLocalConfigurationSnapshotPath(const string & arch, const string & os, const string & subsys, const string & conf)
+{
+	return GetToolCachePath() + L"/" + FormatString(L"config.%0-%1-%2-%3.ecs", os.LowerCase(), arch.LowerCase(), subsys.LowerCase(), conf.LowerCase());
+}
+Registry * MergeLocalConfiguration(const string & arch, const string & os, const string & subsys, const string & conf)
 {
 	ObjectArray<RegistryNode> merge(0x10);
 	for (auto & nn : tool_config->GetSubnodes()) {
@@ -243,8 +313,8 @@ int MakeLocalConfiguration(Console & console)
 		auto parts = nn.Split(L'-');
 		bool accept = true;
 		for (auto & p : parts) {
-			if (string::CompareIgnoreCase(p, state.arch.Name) && string::CompareIgnoreCase(p, state.os.Name) &&
-				string::CompareIgnoreCase(p, state.subsys.Name) && string::CompareIgnoreCase(p, state.conf.Name)) { accept = false; break; }
+			if (string::CompareIgnoreCase(p, arch) && string::CompareIgnoreCase(p, os) &&
+				string::CompareIgnoreCase(p, subsys) && string::CompareIgnoreCase(p, conf)) { accept = false; break; }
 		}
 		if (accept) {
 			SafePointer<RegistryNode> node = tool_config->OpenNode(nn);
@@ -253,8 +323,47 @@ int MakeLocalConfiguration(Console & console)
 	}
 	if (merge.Length()) {
 		SafePointer<RegistryNode> node = CreateMergedNode(merge);
-		local_config = CreateRegistryFromNode(node);
-	} else local_config = CreateRegistry();
+		return CreateRegistryFromNode(node);
+	} else return CreateRegistry();
+}
+Registry * LoadLocalConfigurationSnapshot(const string & path)
+{
+	try {
+		FileStream stream(path, AccessRead, OpenExisting);
+		SafePointer<Registry> config = LoadRegistry(&stream);
+		if (!config) return 0;
+		// A snapshot is valid as long as the tool configuration it was merged from has the same contents.
+		if (config->GetValueString(L"ConfigurationDigest") != state.config_digest) return 0;
+		config->Retain();
+		return config;
+	} catch (...) { return 0; }
+}
+bool SaveLocalConfigurationSnapshot(Registry * config, const string & path)
+{
+	// The cache is shared by all the builds, so the snapshot is written aside and moved into place.
+	// The digest goes into a copy, the merged configuration itself is left as it is.
+	auto temp = MakeTemporaryPath(path);
+	try {
+		SafePointer<Registry> snapshot = CreateRegistryFromNode(config);
+		snapshot->CreateValue(L"ConfigurationDigest", RegistryValueType::String);
+		snapshot->SetValue(L"ConfigurationDigest", state.config_digest);
+		IO::CreateDirectoryTree(IO::Path::GetDirectory(path));
+		FileStream stream(temp, AccessWrite, CreateAlways);
+		snapshot->Save(&stream);
+	} catch (...) {
+		try { IO::RemoveFile(temp); } catch (...) {}
+		return false;
+	}
+	return CommitTemporaryFile(temp, path);
+}
+int MakeLocalConfiguration(Console & console)
+{
+	auto snapshot = GetLocalConfigurationSnapshotPath(state.arch.Name, state.os.Name, state.subsys.Name, state.conf.Name);
+	local_config = LoadLocalConfigurationSnapshot(snapshot);
+	if (!local_config) {
+		local_config = MergeLocalConfiguration(state.arch.Name, state.os.Name, state.subsys.Name, state.conf.Name);
+		SaveLocalConfigurationSnapshot(local_config, snapshot);
+	}
 	auto local = IO::Path::GetDirectory(IO::GetExecutablePath());
 	auto rt_path = local_config->GetValueString(L"RuntimePath");
 	auto obj_path = local_config->GetValueString(L"ObjectPath");
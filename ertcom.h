@@ -2,6 +2,8 @@
 
 #include <EngineRuntime.h>
 
+#include "ertutil.h"
+
 using namespace Engine;
 using namespace Engine::Streaming;
 using namespace Engine::IO;
@@ -80,6 +82,7 @@ struct BuilderState {
 	bool pathout = false;
 	bool build_cache = false;
 	bool print_information = false;
+	bool resource_report = false;
 
 	string runtime_source_path;
 	string runtime_bootstrapper_path;
@@ -87,6 +90,9 @@ struct BuilderState {
 	string runtime_modules_path;
 	string runtime_resources_path;
 
+	string config_digest;
+	string resource_report_json;
+
 	BuildTarget arch;
 	BuildTarget os;
 	BuildTarget subsys;
@@ -127,10 +133,16 @@ void ClearDirectory(const string & path);
 void AppendArgumentLine(Array<string> & cc, const string & arg_word, const string & arg_val);
 void PrintError(handle from, handle to);
 bool CopyFile(const string & from, const string & to);
+bool LinkFile(const string & from, const string & to);
+bool IsFileUpToDate(const string & source, const string & dest);
+string MakeTemporaryPath(const string & path);
+bool CommitTemporaryFile(const string & temp, const string & path);
 
 int ConfigurationInitialize(Console & console);
 int SelectTarget(const string & name, BuildTargetClass cls, Console & console);
 BuildTarget * FindTarget(const string & name, BuildTargetClass cls);
+string GetToolCachePath(void);
+string GetProjectCachePath(void);
 int MakeLocalConfiguration(Console & console);
 int LoadProject(Console & console);
 string GeneralCheckForForcedArchitecture(const string & arch, const string & os, const string & conf, const string & subs);
@@ -0,0 +1,417 @@
+﻿#include "ertpix.h"
+
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ERTPIX_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#define ERTPIX_NEON
+#include <arm_neon.h>
+#endif
+
+namespace
+{
+	inline uint8 MulDiv255(uint32 a, uint32 b) { uint32 v = a * b + 128; return uint8((v + (v >> 8)) >> 8); }
+
+	void ScalarGrayscale(uint8 * p, int count)
+	{
+		for (int i = 0; i < count; i++, p += 4) {
+			uint8 v = uint8((uint32(p[0]) + uint32(p[1]) + uint32(p[2])) / 3);
+			p[0] = p[1] = p[2] = v;
+		}
+	}
+	void ScalarBlindGrayscale(uint8 * p, int count)
+	{
+		for (int i = 0; i < count; i++, p += 4) {
+			uint8 v = 64 + uint8((uint32(p[0]) + uint32(p[1]) + uint32(p[2])) / 6);
+			p[0] = p[1] = p[2] = v;
+		}
+	}
+	void ScalarMultiply(uint8 * p, int count, const uint8 * factors)
+	{
+		for (int i = 0; i < count; i++, p += 4) {
+			p[0] = MulDiv255(p[0], factors[0]);
+			p[1] = MulDiv255(p[1], factors[1]);
+			p[2] = MulDiv255(p[2], factors[2]);
+			p[3] = MulDiv255(p[3], factors[3]);
+		}
+	}
+	void ScalarPremultiply(uint8 * p, int count)
+	{
+		for (int i = 0; i < count; i++, p += 4) {
+			p[0] = MulDiv255(p[0], p[3]);
+			p[1] = MulDiv255(p[1], p[3]);
+			p[2] = MulDiv255(p[2], p[3]);
+		}
+	}
+
+#ifdef ERTPIX_SSE2
+	#define ERTPIX_SHUFFLE(x, imm) _mm_shufflehi_epi16(_mm_shufflelo_epi16(x, imm), imm)
+
+	inline __m128i SSE2Sum3(__m128i x) { return _mm_add_epi16(_mm_add_epi16(x, ERTPIX_SHUFFLE(x, _MM_SHUFFLE(3, 0, 2, 1))), ERTPIX_SHUFFLE(x, _MM_SHUFFLE(3, 1, 0, 2))); }
+	inline __m128i SSE2MulDiv255(__m128i x, __m128i f)
+	{
+		__m128i v = _mm_add_epi16(_mm_mullo_epi16(x, f), _mm_set1_epi16(128));
+		return _mm_srli_epi16(_mm_add_epi16(v, _mm_srli_epi16(v, 8)), 8);
+	}
+	void SSE2Grayscale(uint8 * p, int count, bool blind)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i div3 = _mm_set1_epi16(short(0xAAAB));
+		const __m128i alpha = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+		const __m128i bias = _mm_set1_epi16(64);
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			__m128i px = _mm_loadu_si128(reinterpret_cast<__m128i *>(p + i * 4));
+			__m128i half[2] = { _mm_unpacklo_epi8(px, zero), _mm_unpackhi_epi8(px, zero) };
+			for (auto & x : half) {
+				__m128i q = _mm_mulhi_epu16(SSE2Sum3(x), div3);
+				__m128i v = blind ? _mm_add_epi16(_mm_srli_epi16(q, 2), bias) : _mm_srli_epi16(q, 1);
+				x = _mm_or_si128(_mm_andnot_si128(alpha, v), _mm_and_si128(alpha, x));
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(p + i * 4), _mm_packus_epi16(half[0], half[1]));
+		}
+		if (blind) ScalarBlindGrayscale(p + i * 4, count - i); else ScalarGrayscale(p + i * 4, count - i);
+	}
+	void SSE2Multiply(uint8 * p, int count, const uint8 * factors)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i f = _mm_set_epi16(factors[3], factors[2], factors[1], factors[0], factors[3], factors[2], factors[1], factors[0]);
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			__m128i px = _mm_loadu_si128(reinterpret_cast<__m128i *>(p + i * 4));
+			__m128i lo = SSE2MulDiv255(_mm_unpacklo_epi8(px, zero), f);
+			__m128i hi = SSE2MulDiv255(_mm_unpackhi_epi8(px, zero), f);
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(p + i * 4), _mm_packus_epi16(lo, hi));
+		}
+		ScalarMultiply(p + i * 4, count - i, factors);
+	}
+	void SSE2Premultiply(uint8 * p, int count)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i alpha = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+		const __m128i opaque = _mm_and_si128(alpha, _mm_set1_epi16(255));
+		int i = 0;
+		for (; i + 4 <= count; i += 4) {
+			__m128i px = _mm_loadu_si128(reinterpret_cast<__m128i *>(p + i * 4));
+			__m128i half[2] = { _mm_unpacklo_epi8(px, zero), _mm_unpackhi_epi8(px, zero) };
+			for (auto & x : half) {
+				__m128i f = _mm_or_si128(_mm_andnot_si128(alpha, ERTPIX_SHUFFLE(x, _MM_SHUFFLE(3, 3, 3, 3))), opaque);
+				x = SSE2MulDiv255(x, f);
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(p + i * 4), _mm_packus_epi16(half[0], half[1]));
+		}
+		ScalarPremultiply(p + i * 4, count - i);
+	}
+#endif
+#ifdef ERTPIX_NEON
+	template <int shift> inline uint16x8_t NEONDivide(uint16x8_t s)
+	{
+		const uint16x4_t k = vdup_n_u16(0xAAAB);
+		uint16x8_t q = vcombine_u16(vshrn_n_u32(vmull_u16(vget_low_u16(s), k), 16), vshrn_n_u32(vmull_u16(vget_high_u16(s), k), 16));
+		return vshrq_n_u16(q, shift);
+	}
+	inline uint8x8_t NEONMulDiv255(uint8x8_t c, uint8x8_t f)
+	{
+		uint16x8_t v = vaddq_u16(vmull_u8(c, f), vdupq_n_u16(128));
+		return vshrn_n_u16(vaddq_u16(v, vshrq_n_u16(v, 8)), 8);
+	}
+	inline uint8x16_t NEONMulDiv255(uint8x16_t c, uint8x16_t f) { return vcombine_u8(NEONMulDiv255(vget_low_u8(c), vget_low_u8(f)), NEONMulDiv255(vget_high_u8(c), vget_high_u8(f))); }
+	void NEONGrayscale(uint8 * p, int count, bool blind)
+	{
+		int i = 0;
+		for (; i + 16 <= count; i += 16) {
+			uint8x16x4_t px = vld4q_u8(p + i * 4);
+			uint16x8_t lo = vaddw_u8(vaddl_u8(vget_low_u8(px.val[0]), vget_low_u8(px.val[1])), vget_low_u8(px.val[2]));
+			uint16x8_t hi = vaddw_u8(vaddl_u8(vget_high_u8(px.val[0]), vget_high_u8(px.val[1])), vget_high_u8(px.val[2]));
+			if (blind) {
+				lo = vaddq_u16(NEONDivide<2>(lo), vdupq_n_u16(64));
+				hi = vaddq_u16(NEONDivide<2>(hi), vdupq_n_u16(64));
+			} else {
+				lo = NEONDivide<1>(lo);
+				hi = NEONDivide<1>(hi);
+			}
+			px.val[0] = px.val[1] = px.val[2] = vcombine_u8(vmovn_u16(lo), vmovn_u16(hi));
+			vst4q_u8(p + i * 4, px);
+		}
+		if (blind) ScalarBlindGrayscale(p + i * 4, count - i); else ScalarGrayscale(p + i * 4, count - i);
+	}
+	void NEONMultiply(uint8 * p, int count, const uint8 * factors)
+	{
+		int i = 0;
+		for (; i + 16 <= count; i += 16) {
+			uint8x16x4_t px = vld4q_u8(p + i * 4);
+			for (int c = 0; c < 4; c++) px.val[c] = NEONMulDiv255(px.val[c], vdupq_n_u8(factors[c]));
+			vst4q_u8(p + i * 4, px);
+		}
+		ScalarMultiply(p + i * 4, count - i, factors);
+	}
+	void NEONPremultiply(uint8 * p, int count)
+	{
+		int i = 0;
+		for (; i + 16 <= count; i += 16) {
+			uint8x16x4_t px = vld4q_u8(p + i * 4);
+			for (int c = 0; c < 3; c++) px.val[c] = NEONMulDiv255(px.val[c], px.val[3]);
+			vst4q_u8(p + i * 4, px);
+		}
+		ScalarPremultiply(p + i * 4, count - i);
+	}
+#endif
+
+	PixelKernelLevel current_level = GetPixelKernelMaximalLevel();
+
+	struct ResampleTap
+	{
+		int First;
+		int Count;
+		int Offset;
+	};
+	class ResampleTable
+	{
+	public:
+		Array<ResampleTap> Taps;
+		Array<float> Weights;
+
+		ResampleTable(int source, int dest, PixelFilter filter) : Taps(dest), Weights(0x100)
+		{
+			double scale = double(source) / double(dest);
+			double stretch = max(scale, 1.0);
+			double support = (filter == PixelFilter::Lanczos ? 3.0 : 0.5) * stretch;
+			for (int i = 0; i < dest; i++) {
+				double center = (double(i) + 0.5) * scale;
+				int first = center > support ? int(center - support) : 0;
+				int last = min(int(center + support) + 1, source);
+				ResampleTap tap;
+				tap.First = first;
+				tap.Count = 0;
+				tap.Offset = Weights.Length();
+				double total = 0.0;
+				for (int j = first; j < last; j++) {
+					double w = Kernel((double(j) + 0.5 - center) / stretch, filter);
+					Weights << float(w);
+					total += w;
+					tap.Count++;
+				}
+				if (!tap.Count) {
+					tap.First = min(int(center), source - 1);
+					tap.Count = 1;
+					Weights << 1.0f;
+					total = 1.0;
+				}
+				if (total != 0.0) for (int j = 0; j < tap.Count; j++) Weights[tap.Offset + j] = float(Weights[tap.Offset + j] / total);
+				Taps << tap;
+			}
+		}
+		static double Kernel(double x, PixelFilter filter)
+		{
+			if (filter == PixelFilter::Box) return x >= -0.5 && x < 0.5 ? 1.0 : 0.0;
+			if (x < 0.0) x = -x;
+			if (x < 1.0e-8) return 1.0;
+			if (x >= 3.0) return 0.0;
+			double px = 3.14159265358979323846 * x;
+			return 3.0 * sin(px) * sin(px / 3.0) / (px * px);
+		}
+	};
+	// Accumulates one RGBA pixel from the weighted taps, source pixels are 4 floats each and Step floats apart.
+	inline void ResamplePixel(const float * source, int step, const float * weights, int count, float * dest)
+	{
+#if defined(ERTPIX_SSE2)
+		if (current_level == PixelKernelLevel::SSE2) {
+			__m128 acc = _mm_setzero_ps();
+			for (int i = 0; i < count; i++, source += step) acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(source), _mm_set1_ps(weights[i])));
+			_mm_storeu_ps(dest, acc);
+			return;
+		}
+#elif defined(ERTPIX_NEON)
+		if (current_level == PixelKernelLevel::NEON) {
+			float32x4_t acc = vdupq_n_f32(0.0f);
+			for (int i = 0; i < count; i++, source += step) acc = vmlaq_n_f32(acc, vld1q_f32(source), weights[i]);
+			vst1q_f32(dest, acc);
+			return;
+		}
+#endif
+		float r = 0.0f, g = 0.0f, b = 0.0f, a = 0.0f;
+		for (int i = 0; i < count; i++, source += step) {
+			r += source[0] * weights[i];
+			g += source[1] * weights[i];
+			b += source[2] * weights[i];
+			a += source[3] * weights[i];
+		}
+		dest[0] = r; dest[1] = g; dest[2] = b; dest[3] = a;
+	}
+
+
+	void ApplyGrayscale(const PixelBuffer & buffer, bool blind)
+	{
+		for (int y = 0; y < buffer.Height; y++) {
+			auto row = buffer.Data + intptr(y) * buffer.Stride;
+#if defined(ERTPIX_SSE2)
+			if (current_level == PixelKernelLevel::SSE2) { SSE2Grayscale(row, buffer.Width, blind); continue; }
+#elif defined(ERTPIX_NEON)
+			if (current_level == PixelKernelLevel::NEON) { NEONGrayscale(row, buffer.Width, blind); continue; }
+#endif
+			if (blind) ScalarBlindGrayscale(row, buffer.Width); else ScalarGrayscale(row, buffer.Width);
+		}
+	}
+	void ApplyMultiply(const PixelBuffer & buffer, const uint8 * factors)
+	{
+		for (int y = 0; y < buffer.Height; y++) {
+			auto row = buffer.Data + intptr(y) * buffer.Stride;
+#if defined(ERTPIX_SSE2)
+			if (current_level == PixelKernelLevel::SSE2) { SSE2Multiply(row, buffer.Width, factors); continue; }
+#elif defined(ERTPIX_NEON)
+			if (current_level == PixelKernelLevel::NEON) { NEONMultiply(row, buffer.Width, factors); continue; }
+#endif
+			ScalarMultiply(row, buffer.Width, factors);
+		}
+	}
+	Codec::Frame * CreateFrameLike(Codec::Frame * frame, int width, int height, Codec::AlphaMode alpha)
+	{
+		SafePointer<Codec::Frame> result = new Codec::Frame(width, height, -1, Codec::PixelFormat::R8G8B8A8, alpha, frame->GetScanOrigin());
+		result->DpiUsage = frame->DpiUsage;
+		result->Retain();
+		return result;
+	}
+}
+
+PixelKernelLevel GetPixelKernelLevel(void) { return current_level; }
+PixelKernelLevel GetPixelKernelMaximalLevel(void)
+{
+#if defined(ERTPIX_SSE2)
+	return PixelKernelLevel::SSE2;
+#elif defined(ERTPIX_NEON)
+	return PixelKernelLevel::NEON;
+#else
+	return PixelKernelLevel::Scalar;
+#endif
+}
+void SetPixelKernelLevel(PixelKernelLevel level) { current_level = level == GetPixelKernelMaximalLevel() ? level : PixelKernelLevel::Scalar; }
+string GetPixelKernelLevelName(PixelKernelLevel level)
+{
+	if (level == PixelKernelLevel::SSE2) return L"SSE2";
+	else if (level == PixelKernelLevel::NEON) return L"NEON";
+	else return L"Scalar";
+}
+bool GetFramePixels(Codec::Frame * frame, PixelBuffer & buffer)
+{
+	if (frame->GetPixelFormat() != Codec::PixelFormat::R8G8B8A8) return false;
+	buffer.Data = frame->GetData();
+	buffer.Width = frame->GetWidth();
+	buffer.Height = frame->GetHeight();
+	buffer.Stride = frame->GetScanLineLength();
+	return true;
+}
+void PixelGrayscale(const PixelBuffer & buffer) { ApplyGrayscale(buffer, false); }
+void PixelBlindGrayscale(const PixelBuffer & buffer) { ApplyGrayscale(buffer, true); }
+void PixelTint(const PixelBuffer & buffer, uint8 r, uint8 g, uint8 b, uint8 a)
+{
+	uint8 factors[4] = { r, g, b, a };
+	ApplyMultiply(buffer, factors);
+}
+void PixelOpacity(const PixelBuffer & buffer, uint8 opacity, bool premultiplied)
+{
+	uint8 factors[4] = { uint8(premultiplied ? opacity : 255), uint8(premultiplied ? opacity : 255), uint8(premultiplied ? opacity : 255), opacity };
+	ApplyMultiply(buffer, factors);
+}
+void PixelPremultiply(const PixelBuffer & buffer)
+{
+	for (int y = 0; y < buffer.Height; y++) {
+		auto row = buffer.Data + intptr(y) * buffer.Stride;
+#if defined(ERTPIX_SSE2)
+		if (current_level == PixelKernelLevel::SSE2) { SSE2Premultiply(row, buffer.Width); continue; }
+#elif defined(ERTPIX_NEON)
+		if (current_level == PixelKernelLevel::NEON) { NEONPremultiply(row, buffer.Width); continue; }
+#endif
+		ScalarPremultiply(row, buffer.Width);
+	}
+}
+void PixelDownscale2(const PixelBuffer & source, const PixelBuffer & dest, bool premultiplied)
+{
+	for (int y = 0; y < dest.Height; y++) {
+		int sy0 = min(y * 2, source.Height - 1);
+		int sy1 = min(y * 2 + 1, source.Height - 1);
+		auto row0 = source.Data + intptr(sy0) * source.Stride;
+		auto row1 = source.Data + intptr(sy1) * source.Stride;
+		auto out = dest.Data + intptr(y) * dest.Stride;
+		for (int x = 0; x < dest.Width; x++, out += 4) {
+			int sx0 = min(x * 2, source.Width - 1) * 4;
+			int sx1 = min(x * 2 + 1, source.Width - 1) * 4;
+			const uint8 * px[4] = { row0 + sx0, row0 + sx1, row1 + sx0, row1 + sx1 };
+			uint32 sa = uint32(px[0][3]) + px[1][3] + px[2][3] + px[3][3];
+			if (premultiplied) {
+				for (int c = 0; c < 4; c++) out[c] = uint8((uint32(px[0][c]) + px[1][c] + px[2][c] + px[3][c] + 2) / 4);
+			} else {
+				for (int c = 0; c < 3; c++) {
+					uint32 sc = uint32(px[0][c]) * px[0][3] + uint32(px[1][c]) * px[1][3] + uint32(px[2][c]) * px[2][3] + uint32(px[3][c]) * px[3][3];
+					out[c] = sa ? uint8((sc + sa / 2) / sa) : 0;
+				}
+				out[3] = uint8((sa + 2) / 4);
+			}
+		}
+	}
+}
+Codec::Frame * CreatePremultipliedFrame(Codec::Frame * frame)
+{
+	SafePointer<Codec::Frame> source = frame->ConvertFormat(Codec::PixelFormat::R8G8B8A8, Codec::AlphaMode::Normal, frame->GetScanOrigin());
+	SafePointer<Codec::Frame> result = CreateFrameLike(frame, frame->GetWidth(), frame->GetHeight(), Codec::AlphaMode::Premultiplied);
+	PixelBuffer from, to;
+	GetFramePixels(source, from);
+	GetFramePixels(result, to);
+	for (int y = 0; y < to.Height; y++) MemoryCopy(to.Data + intptr(y) * to.Stride, from.Data + intptr(y) * from.Stride, to.Width * 4);
+	PixelPremultiply(to);
+	result->Retain();
+	return result;
+}
+Codec::Frame * CreateDownscaledFrame(Codec::Frame * frame)
+{
+	SafePointer<Codec::Frame> source = frame->ConvertFormat(Codec::PixelFormat::R8G8B8A8, frame->GetAlphaMode(), frame->GetScanOrigin());
+	SafePointer<Codec::Frame> result = CreateFrameLike(frame, max((frame->GetWidth() + 1) / 2, 1), max((frame->GetHeight() + 1) / 2, 1), frame->GetAlphaMode());
+	PixelBuffer from, to;
+	GetFramePixels(source, from);
+	GetFramePixels(result, to);
+	PixelDownscale2(from, to, frame->GetAlphaMode() == Codec::AlphaMode::Premultiplied);
+	result->Retain();
+	return result;
+}
+void PixelResample(const PixelBuffer & source, const PixelBuffer & dest, PixelFilter filter)
+{
+	ResampleTable horizontal(source.Width, dest.Width, filter);
+	ResampleTable vertical(source.Height, dest.Height, filter);
+	Array<float> row(0x100), transit(0x100), pixel(4);
+	row.SetLength(source.Width * 4);
+	transit.SetLength(dest.Width * source.Height * 4);
+	pixel.SetLength(4);
+	for (int y = 0; y < source.Height; y++) {
+		auto src = source.Data + intptr(y) * source.Stride;
+		for (int x = 0; x < source.Width * 4; x++) row[x] = float(src[x]);
+		auto out = transit.GetBuffer() + intptr(y) * dest.Width * 4;
+		for (int x = 0; x < dest.Width; x++) {
+			auto & tap = horizontal.Taps[x];
+			ResamplePixel(row.GetBuffer() + tap.First * 4, 4, horizontal.Weights.GetBuffer() + tap.Offset, tap.Count, out + x * 4);
+		}
+	}
+	for (int y = 0; y < dest.Height; y++) {
+		auto & tap = vertical.Taps[y];
+		auto out = dest.Data + intptr(y) * dest.Stride;
+		for (int x = 0; x < dest.Width; x++, out += 4) {
+			ResamplePixel(transit.GetBuffer() + (intptr(tap.First) * dest.Width + x) * 4, dest.Width * 4, vertical.Weights.GetBuffer() + tap.Offset, tap.Count, pixel.GetBuffer());
+			float a = min(max(pixel[3] + 0.5f, 0.0f), 255.0f);
+			out[3] = uint8(a);
+			for (int c = 0; c < 3; c++) out[c] = uint8(min(max(pixel[c] + 0.5f, 0.0f), float(out[3])));
+		}
+	}
+}
+Codec::Frame * CreateResampledFrame(Codec::Frame * frame, int width, int height, PixelFilter filter)
+{
+	SafePointer<Codec::Frame> source = CreatePremultipliedFrame(frame);
+	SafePointer<Codec::Frame> result = CreateFrameLike(frame, width, height, Codec::AlphaMode::Premultiplied);
+	PixelBuffer from, to;
+	GetFramePixels(source, from);
+	GetFramePixels(result, to);
+	PixelResample(from, to, filter);
+	SafePointer<Codec::Frame> normal = result->ConvertFormat(Codec::PixelFormat::R8G8B8A8, Codec::AlphaMode::Normal, frame->GetScanOrigin());
+	normal->DpiUsage = frame->DpiUsage;
+	normal->Retain();
+	return normal;
+}
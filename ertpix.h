@@ -0,0 +1,35 @@
+#pragma once
+
+#include <EngineRuntime.h>
+
+using namespace Engine;
+
+enum class PixelKernelLevel { Scalar, SSE2, NEON };
+enum class PixelFilter { Box, Lanczos };
+
+struct PixelBuffer
+{
+	uint8 * Data;
+	int Width;
+	int Height;
+	int Stride;
+};
+
+// All the kernels operate on R8G8B8A8 pixels, 4 bytes each, rows are Stride bytes apart.
+PixelKernelLevel GetPixelKernelLevel(void);
+PixelKernelLevel GetPixelKernelMaximalLevel(void);
+void SetPixelKernelLevel(PixelKernelLevel level);
+string GetPixelKernelLevelName(PixelKernelLevel level);
+
+bool GetFramePixels(Codec::Frame * frame, PixelBuffer & buffer);
+void PixelGrayscale(const PixelBuffer & buffer);
+void PixelBlindGrayscale(const PixelBuffer & buffer);
+void PixelTint(const PixelBuffer & buffer, uint8 r, uint8 g, uint8 b, uint8 a);
+void PixelOpacity(const PixelBuffer & buffer, uint8 opacity, bool premultiplied);
+void PixelPremultiply(const PixelBuffer & buffer);
+void PixelDownscale2(const PixelBuffer & source, const PixelBuffer & dest, bool premultiplied);
+// Resampling expects premultiplied alpha, the result keeps every color channel within its alpha.
+void PixelResample(const PixelBuffer & source, const PixelBuffer & dest, PixelFilter filter);
+Codec::Frame * CreatePremultipliedFrame(Codec::Frame * frame);
+Codec::Frame * CreateDownscaledFrame(Codec::Frame * frame);
+Codec::Frame * CreateResampledFrame(Codec::Frame * frame, int width, int height, PixelFilter filter);
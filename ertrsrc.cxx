@@ -0,0 +1,1438 @@
+﻿#include "ertrsrc.h"
+#include "ertpix.h"
+
+enum class ResourceMode { Windows, MacOSX, Linux };
+
+struct UniqueIcon
+{
+	string SourcePath;
+	string ConvertedPath;
+	string Reference;
+	string ContentKey;
+};
+class IconConversionTask : public IDispatchTask
+{
+public:
+	string SourcePath;
+	string OutputPath;
+	string CachePath;
+	string IconCodec;
+	Array<int> Sizes;
+	bool ReadCache;
+	bool Cached;
+	bool Succeeded;
+	int Synthesized;
+
+	IconConversionTask(void) : Sizes(0x10), ReadCache(true), Cached(false), Succeeded(false), Synthesized(0) {}
+	// A cache entry is only trusted when it matches the digest stored next to it.
+	DataBlock * LoadCacheEntry(void)
+	{
+		try {
+			FileStream cache(CachePath, AccessRead, OpenExisting);
+			FileStream digest_stream(CachePath + L".digest", AccessRead, OpenExisting);
+			TextReader reader(&digest_stream, Encoding::UTF8);
+			auto digest = reader.ReadLine();
+			SafePointer<DataBlock> cache_data = cache.ReadAll();
+			if (FormatDigest(ComputeDigest(cache_data->GetBuffer(), cache_data->Length())) != digest) return 0;
+			cache_data->Retain();
+			return cache_data;
+		} catch (...) { return 0; }
+	}
+	void StoreCacheEntry(const DataBlock * data)
+	{
+		// The cache is shared by the targets and the builds, so the entry and its digest are written aside and moved into place.
+		try {
+			IO::CreateDirectoryTree(IO::Path::GetDirectory(CachePath));
+			auto temp = MakeTemporaryPath(CachePath);
+			if (!LinkFile(OutputPath, temp) || !CommitTemporaryFile(temp, CachePath)) return;
+			auto digest_file = CachePath + L".digest";
+			auto digest_temp = MakeTemporaryPath(digest_file);
+			try {
+				FileStream digest_stream(digest_temp, AccessWrite, CreateAlways);
+				TextWriter writer(&digest_stream, Encoding::UTF8);
+				writer.WriteLine(FormatDigest(ComputeDigest(data->GetBuffer(), data->Length())));
+			} catch (...) {
+				try { IO::RemoveFile(digest_temp); } catch (...) {}
+				return;
+			}
+			CommitTemporaryFile(digest_temp, digest_file);
+		} catch (...) {}
+	}
+	virtual void DoTask(IDispatchQueue * queue) override
+	{
+		SafePointer<DataBlock> cache_data;
+		if (ReadCache && CachePath.Length()) cache_data = LoadCacheEntry();
+		if (cache_data) {
+			// An output that already matches the cache is left untouched to keep its time.
+			try {
+				FileStream output(OutputPath, AccessRead, OpenExisting);
+				SafePointer<DataBlock> output_data = output.ReadAll();
+				if (*cache_data == *output_data) { Cached = Succeeded = true; return; }
+			} catch (...) {}
+			if (LinkFile(CachePath, OutputPath)) {
+				Cached = Succeeded = true;
+				return;
+			}
+		}
+		SafePointer<DataBlock> encoded;
+		try {
+			FileStream source(SourcePath, AccessRead, OpenExisting);
+			SafePointer<Codec::Image> decoded = Codec::DecodeImage(&source);
+			if (!decoded) throw Exception();
+			SafePointer<Codec::Image> image = new Codec::Image;
+			// Frames present in the source keep their source order, synthesized ones follow them.
+			for (int i = 0; i < decoded->Frames.Length(); i++) {
+				auto frame = decoded->Frames.ElementAt(i);
+				for (auto & s : Sizes) if (frame->GetWidth() == s && frame->GetHeight() == s) { image->Frames.Append(frame); break; }
+			}
+			for (auto & s : Sizes) {
+				Codec::Frame * exact = 0;
+				Codec::Frame * larger = 0;
+				for (int i = 0; i < decoded->Frames.Length(); i++) {
+					auto frame = decoded->Frames.ElementAt(i);
+					if (frame->GetWidth() == s && frame->GetHeight() == s) { exact = frame; break; }
+					if (frame->GetWidth() < s || frame->GetHeight() < s) continue;
+					if (!larger || frame->GetWidth() * frame->GetHeight() < larger->GetWidth() * larger->GetHeight()) larger = frame;
+				}
+				if (exact || !larger) continue;
+				// Missing sizes are synthesized from the nearest larger frame. The conversions already run on
+				// the pool of ConvertIcons, so the resampling is done in place.
+				SafePointer<Codec::Frame> frame = CreateResampledFrame(larger, s, s, PixelFilter::Lanczos);
+				image->Frames.Append(frame);
+				Synthesized++;
+			}
+			if (!image->Frames.Length()) throw Exception();
+			MemoryStream encoded_stream(0x10000);
+			Codec::EncodeImage(&encoded_stream, image, IconCodec);
+			encoded_stream.Seek(0, Begin);
+			encoded = encoded_stream.ReadAll();
+			// The output may be a link to a cache entry, so it is replaced rather than rewritten in place.
+			try { IO::RemoveFile(OutputPath); } catch (...) {}
+			{
+				FileStream output_stream(OutputPath, AccessReadWrite, CreateAlways);
+				output_stream.WriteArray(encoded);
+			}
+			Succeeded = true;
+		} catch (...) { return; }
+		if (CachePath.Length()) StoreCacheEntry(encoded);
+	}
+};
+// Linux resource pack layout: header, hash buckets, entries, UTF-8 names, then page-aligned payloads.
+// An entry's name is the loose file name without ".ersrc", i.e. "name" or "name.locale".
+struct ResourcePackHeader
+{
+	uint8 Signature[8];
+	uint32 Version;
+	uint32 PageSize;
+	uint32 EntryCount;
+	uint32 BucketCount;
+	uint32 BucketsOffset;
+	uint32 EntriesOffset;
+	uint32 NamesOffset;
+	uint32 NamesLength;
+};
+struct ResourcePackEntry
+{
+	uint64 Hash;
+	uint32 Next;
+	uint32 NameOffset;
+	uint32 NameLength;
+	uint32 Flags;
+	uint64 DataOffset;
+	uint64 DataLength;
+};
+#define ERTRP_SIGNATURE		"ertrpack"
+#define ERTRP_VERSION		1
+#define ERTRP_PAGE_SIZE		0x1000
+#define ERTRP_NO_ENTRY		0xFFFFFFFF
+#define ERTRP_FLAG_STORED	0x0000
+#define ERTRP_FLAG_COMPRESSED	0x0001
+
+// A payload of a resource with a compression chain is this header followed by the data, either
+// Storage chain-compressed or stored as is when the compression does not help.
+struct ResourceCompressionHeader
+{
+	uint8 Signature[8];
+	uint32 Version;
+	uint32 Flags;
+	uint64 OriginalLength;
+	uint64 DataLength;
+};
+#define ERTRC_SIGNATURE		"ertrcomp"
+#define ERTRC_VERSION		2
+#define ERTRC_FLAG_STORED	0x0000
+#define ERTRC_FLAG_COMPRESSED	0x0001
+
+bool ReadResourceCompressionHeader(Stream * stream, ResourceCompressionHeader & header)
+{
+	try {
+		auto length = stream->Length();
+		if (length < sizeof(header)) return false;
+		stream->Seek(0, Begin);
+		stream->Read(&header, sizeof(header));
+		if (MemoryCompare(header.Signature, ERTRC_SIGNATURE, 8) || header.Version != ERTRC_VERSION) return false;
+		return sizeof(header) + header.DataLength == length;
+	} catch (...) { return false; }
+}
+
+class ResourceInputTask : public IDispatchTask
+{
+public:
+	string Path;
+	uint64 Size;
+	uint64 Time;
+	uint64 Digest;
+	bool Known;
+	bool Succeeded;
+
+	ResourceInputTask(const string & path) : Path(path), Size(0), Time(0), Digest(0), Known(false), Succeeded(false) {}
+	virtual void DoTask(IDispatchQueue * queue) override
+	{
+		try {
+			FileStream source(Path, AccessRead, OpenExisting);
+			auto size = source.Length();
+			auto time = IO::DateTime::GetFileAlterTime(source.Handle()).Ticks;
+			// The content is only read again when the size or the time differs from the previous record.
+			if (!Known || size != Size || time != Time) {
+				SafePointer<DataBlock> data = source.ReadAll();
+				Digest = ComputeDigest(data->GetBuffer(), data->Length());
+				Size = size;
+				Time = time;
+			}
+			Succeeded = true;
+		} catch (...) {}
+	}
+};
+struct ApplicationResource
+{
+	string SourcePath;
+	string OriginalPath;
+	string Name;
+	string Locale;
+	string CompressionName;
+	MethodChain Compression;
+	bool Compressed;
+};
+struct ApplicationFileFormat
+{
+	string Extension;
+	string Description;
+	UniqueIcon * Icon;
+	bool CanCreate;
+	bool IsProtocol;
+};
+
+struct {
+	ResourceMode mode;
+	SafeArray<UniqueIcon> icon_database = SafeArray<UniqueIcon>(0x20);
+	Array<ApplicationResource> resources = Array<ApplicationResource>(0x20);
+	Array<ApplicationFileFormat> file_formats = Array<ApplicationFileFormat>(0x20);
+	ObjectArray<IconConversionTask> icon_tasks = ObjectArray<IconConversionTask>(0x20);
+	UniqueIcon * application_icon = 0;
+	int file_icon_counter = 0;
+	bool property_disable_hidpi = false;
+	bool property_disable_dock_icon = false;
+	bool property_needs_root_elevation = false;
+	bool property_pack_resources = false;
+	MethodChain resource_compression = 0;
+	string resource_manifest_file;
+	string resource_script_file;
+	string resource_object_file;
+	string resource_object_file_log;
+	string resource_file_formats_file;
+	string resource_pack_file;
+} res_state;
+
+SafePointer<RegistryNode> configuration;
+
+bool IsValidResourceName(const string & value)
+{
+	for (int i = 0; i < value.Length(); i++) {
+		auto c = value[i];
+		if ((c < L'a' || c > L'z') && (c < L'A' || c > L'Z') && (c < L'0' || c > L'9') && c != L'_') return false;
+	}
+	return true;
+}
+string GetResourceInnerName(const ApplicationResource & resource)
+{
+	return resource.Locale.Length() ? (resource.Name + L"." + resource.Locale) : resource.Name;
+}
+bool ParseMethodChain(const string & text, MethodChain & chain)
+{
+	chain = 0;
+	for (auto & word : text.Replace(L',', L' ').Split(L' ')) {
+		if (!word.Length() || string::CompareIgnoreCase(word, L"none") == 0) continue;
+		if (chain.Length() >= 8) return false;
+		CompressionMethod method;
+		if (string::CompareIgnoreCase(word, L"huffman") == 0) method = CompressionMethod::Huffman;
+		else if (string::CompareIgnoreCase(word, L"lzw") == 0) method = CompressionMethod::LempelZivWelch;
+		else if (string::CompareIgnoreCase(word, L"rle8") == 0) method = CompressionMethod::RunLengthEncoding8bit;
+		else if (string::CompareIgnoreCase(word, L"rle16") == 0) method = CompressionMethod::RunLengthEncoding16bit;
+		else if (string::CompareIgnoreCase(word, L"rle32") == 0) method = CompressionMethod::RunLengthEncoding32bit;
+		else if (string::CompareIgnoreCase(word, L"rle64") == 0) method = CompressionMethod::RunLengthEncoding64bit;
+		else if (string::CompareIgnoreCase(word, L"rle128") == 0) method = CompressionMethod::RunLengthEncoding128bit;
+		else return false;
+		chain = chain.Append(method);
+	}
+	return true;
+}
+int RegisterResource(const string & name, const string & path, Console & console)
+{
+	if (!IsValidResourceName(name)) {
+		if (!state.silent) console << TextColor(ConsoleColor::Red) << FormatString(L"Invalid resource name \"%0\".", name) << TextColorDefault() << LineFeed();
+		return ERTBT_INVALID_RESOURCE;
+	}
+	ApplicationResource resource;
+	resource.SourcePath = path;
+	resource.Name = name;
+	resource.Locale = L"";
+	resource.Compression = 0;
+	resource.Compressed = false;
+	res_state.resources.Append(resource);
+	return ERTBT_SUCCESS;
+}
+
+string GetIconContentKey(const string & path, const Array<int> & sizes, const string & codec)
+{
+	try {
+		FileStream source(path, AccessRead, OpenExisting);
+		SafePointer<DataBlock> data = source.ReadAll();
+		uint64 digest = ComputeDigest(data->GetBuffer(), data->Length());
+		digest = ComputeDigest(sizes.GetBuffer(), sizes.Length() * sizeof(int), digest);
+		SafePointer<DataBlock> codec_data = (codec + L"|lanczos").EncodeSequence(Encoding::UTF8, false);
+		digest = ComputeDigest(codec_data->GetBuffer(), codec_data->Length(), digest);
+		return FormatDigest(digest);
+	} catch (...) { return L""; }
+}
+int BuildIcon(const string & path, UniqueIcon ** icon, Console & console, bool is_file_icon = false)
+{
+	for (auto & i : res_state.icon_database) if (i.SourcePath == path) {
+		if (icon) *icon = &i;
+		return ERTBT_SUCCESS;
+	}
+	Array<int> sizes(0x10);
+	SafePointer<RegistryNode> sizes_node = configuration->OpenNode(L"IconSizes");
+	if (sizes_node) for (auto & v : sizes_node->GetValues()) sizes << sizes_node->GetValueInteger(v);
+	auto codec = configuration->GetValueString(L"IconCodec");
+	auto key = GetIconContentKey(path, sizes, codec);
+	if (key.Length()) for (auto & i : res_state.icon_database) if (i.ContentKey == key) {
+		if (icon) *icon = &i;
+		return ERTBT_SUCCESS;
+	}
+	auto extension = configuration->GetValueString(L"IconExtension");
+	auto output = IO::ExpandPath(state.project_object_path + L"/" + IO::Path::GetFileNameWithoutExtension(path) + L"." + extension);
+	UniqueIcon result;
+	result.SourcePath = path;
+	result.ConvertedPath = output;
+	result.ContentKey = key;
+	if (res_state.mode == ResourceMode::Windows) {
+		result.Reference = string(res_state.icon_database.Length());
+	} else if (res_state.mode == ResourceMode::MacOSX) {
+		if (is_file_icon) {
+			res_state.file_icon_counter++;
+			result.Reference = L"FileIcon" + string(res_state.file_icon_counter);
+		} else result.Reference = L"AppIcon";
+	} else if (res_state.mode == ResourceMode::Linux) {
+		if (is_file_icon) {
+			res_state.file_icon_counter++;
+			result.Reference = L"file_format_" + string(res_state.file_icon_counter) + L".ico";
+		} else result.Reference = state.project_output_name + L".ico";
+	}
+	res_state.icon_database.Append(result);
+	if (icon) *icon = &res_state.icon_database.LastElement();
+	if (!state.clean) {
+		try {
+			FileStream src(path, AccessRead, OpenExisting);
+			FileStream out(output, AccessRead, OpenExisting);
+			auto src_time = IO::DateTime::GetFileAlterTime(src.Handle());
+			auto out_time = IO::DateTime::GetFileAlterTime(out.Handle());
+			if (out_time > src_time && out_time > state.project_time) return ERTBT_SUCCESS;
+		} catch (...) {}
+	}
+	SafePointer<IconConversionTask> task = new IconConversionTask;
+	task->SourcePath = path;
+	task->OutputPath = output;
+	if (key.Length()) task->CachePath = GetProjectCachePath() + L"/icons/" + key + L"." + extension;
+	task->ReadCache = !state.clean;
+	task->IconCodec = codec;
+	task->Sizes = sizes;
+	res_state.icon_tasks.Append(task);
+	return ERTBT_SUCCESS;
+}
+int ConvertIcons(Console & console)
+{
+	if (!res_state.icon_tasks.Length()) return ERTBT_SUCCESS;
+	SafePointer<ThreadPool> pool;
+	if (res_state.icon_tasks.Length() > 1) try { pool = new ThreadPool; } catch (...) {}
+	if (pool) {
+		for (auto & t : res_state.icon_tasks) pool->SubmitTask(&t);
+		pool->Wait();
+	} else for (auto & t : res_state.icon_tasks) t.DoTask(0);
+	int error = ERTBT_SUCCESS;
+	for (auto & t : res_state.icon_tasks) {
+		if (!state.silent) console << L"Converting icon file " << TextColor(ConsoleColor::Cyan) << IO::Path::GetFileName(t.SourcePath) << TextColorDefault() << L"...";
+		if (!t.Succeeded) {
+			if (!state.silent) console << TextColor(ConsoleColor::Red) << L"Failed" << TextColorDefault() << LineFeed();
+			error = ERTBT_INVALID_FILE_FORMAT;
+		} else if (!state.silent) {
+			if (t.Cached) console << TextColor(ConsoleColor::Green) << L"Cached" << TextColorDefault() << LineFeed();
+			else if (t.Synthesized) console << TextColor(ConsoleColor::Green) << L"Succeed" << TextColorDefault() << L" (" << string(t.Synthesized) << L" sizes resampled)" << LineFeed();
+			else console << TextColor(ConsoleColor::Green) << L"Succeed" << TextColorDefault() << LineFeed();
+		}
+	}
+	res_state.icon_tasks.Clear();
+	return error;
+}
+int ExtractResources(Console & console, RegistryNode * node = 0, const string & locale = L"")
+{
+	SafePointer<RegistryNode> current;
+	if (node) current.SetRetain(node); else current = state.project->OpenNode(L"Resources");
+	if (!current) return ERTBT_SUCCESS;
+	for (auto & v : current->GetValues()) {
+		ApplicationResource resource;
+		auto pre_path = current->GetValueString(v);
+		if (pre_path[0] == L'@') resource.SourcePath = ExpandPath(pre_path.Fragment(1, -1), state.runtime_resources_path);
+		else resource.SourcePath = ExpandPath(pre_path, state.project_root_path);
+		if (!IsValidResourceName(v)) {
+			if (!state.silent) console << TextColor(ConsoleColor::Red) << FormatString(L"Invalid resource name \"%0\".", v) << TextColorDefault() << LineFeed();
+			return ERTBT_INVALID_RESOURCE;
+		}
+		resource.Name = v;
+		resource.Locale = locale;
+		resource.Compression = 0;
+		resource.Compressed = false;
+		res_state.resources.Append(resource);
+	}
+	for (auto & v : current->GetSubnodes()) {
+		auto cand = v.LowerCase();
+		if (cand.Length() != 2) {
+			if (!state.silent) console << TextColor(ConsoleColor::Red) << FormatString(L"Invalid locale name \"%0\".", v) << TextColorDefault() << LineFeed();
+			return ERTBT_INVALID_RESOURCE;
+		}
+		SafePointer<RegistryNode> sub = current->OpenNode(v);
+		auto error = ExtractResources(console, sub, cand);
+		if (error) return error;
+	}
+	return ERTBT_SUCCESS;
+}
+int CompressResources(Console & console)
+{
+	if (!ParseMethodChain(state.project->GetValueString(L"ResourceCompression"), res_state.resource_compression)) {
+		if (!state.silent) console << TextColor(ConsoleColor::Red) << L"Invalid resource compression method chain." << TextColorDefault() << LineFeed();
+		return ERTBT_INVALID_RESOURCE;
+	}
+	SafePointer<RegistryNode> overrides = state.project->OpenNode(L"ResourceCompressionOverrides");
+	SafePointer<ThreadPool> pool;
+	for (auto & r : res_state.resources) {
+		r.OriginalPath = r.SourcePath;
+		r.Compression = res_state.resource_compression;
+		auto chain_text = state.project->GetValueString(L"ResourceCompression");
+		if (overrides && overrides->GetValueType(r.Name) == RegistryValueType::String) {
+			chain_text = overrides->GetValueString(r.Name);
+			if (!ParseMethodChain(chain_text, r.Compression)) {
+				if (!state.silent) console << TextColor(ConsoleColor::Red) << FormatString(L"Invalid compression method chain for resource \"%0\".", r.Name) << TextColorDefault() << LineFeed();
+				return ERTBT_INVALID_RESOURCE;
+			}
+		}
+		if (!r.Compression.Length()) continue;
+		r.CompressionName = chain_text.LowerCase();
+		auto output = IO::ExpandPath(state.project_object_path + L"/" + GetResourceInnerName(r) + L".ersrc");
+		uint64 original_length = 0, compressed_length = 0;
+		bool cached = false, payload_compressed = false;
+		if (!state.clean) {
+			try {
+				FileStream src(r.SourcePath, AccessRead, OpenExisting);
+				FileStream out(output, AccessRead, OpenExisting);
+				auto src_time = IO::DateTime::GetFileAlterTime(src.Handle());
+				auto out_time = IO::DateTime::GetFileAlterTime(out.Handle());
+				ResourceCompressionHeader header;
+				if (out_time > src_time && out_time > state.project_time && ReadResourceCompressionHeader(&out, header) && header.OriginalLength == src.Length()) {
+					original_length = src.Length();
+					compressed_length = out.Length();
+					payload_compressed = header.Flags == ERTRC_FLAG_COMPRESSED;
+					cached = true;
+				}
+			} catch (...) {}
+		}
+		if (!state.silent) console << L"Compressing resource " << TextColor(ConsoleColor::Cyan) << GetResourceInnerName(r) << TextColorDefault() << L"...";
+		if (!cached) {
+			try {
+				FileStream src(r.SourcePath, AccessRead, OpenExisting);
+				SafePointer<DataBlock> data = src.ReadAll();
+				original_length = data->Length();
+				// Payloads are kept in the project cache by source content and chain, the object directory links to them.
+				SafePointer<DataBlock> chain_data = chain_text.LowerCase().EncodeSequence(Encoding::UTF8, false);
+				uint64 key = ComputeDigest(data->GetBuffer(), data->Length());
+				key = ComputeDigest(chain_data->GetBuffer(), chain_data->Length(), key);
+				auto cache_path = GetProjectCachePath() + L"/resources/" + FormatDigest(key) + L".ersrc";
+				SafePointer<DataBlock> buffer_data;
+				if (!state.clean) try {
+					FileStream cache(cache_path, AccessRead, OpenExisting);
+					ResourceCompressionHeader header;
+					if (ReadResourceCompressionHeader(&cache, header) && header.OriginalLength == original_length) {
+						cache.Seek(0, Begin);
+						buffer_data = cache.ReadAll();
+						payload_compressed = header.Flags == ERTRC_FLAG_COMPRESSED;
+						cached = true;
+					}
+				} catch (...) {}
+				if (!buffer_data) {
+					if (!pool) pool = new ThreadPool;
+					Array<uint8> compressed(0x10000);
+					if (!ChainCompress(compressed, data->GetBuffer(), data->Length(), r.Compression, CompressionQuality::Variative, pool, 0x100000)) throw Exception();
+					// The header is always there, so a stored payload is never mistaken for a compressed one.
+					ResourceCompressionHeader header;
+					MemoryCopy(header.Signature, ERTRC_SIGNATURE, 8);
+					header.Version = ERTRC_VERSION;
+					header.Flags = sizeof(header) + compressed.Length() < original_length ? ERTRC_FLAG_COMPRESSED : ERTRC_FLAG_STORED;
+					header.OriginalLength = original_length;
+					header.DataLength = header.Flags == ERTRC_FLAG_COMPRESSED ? compressed.Length() : original_length;
+					MemoryStream buffer(0x10000);
+					buffer.Write(&header, sizeof(header));
+					if (header.Flags == ERTRC_FLAG_COMPRESSED) buffer.Write(compressed.GetBuffer(), compressed.Length());
+					else buffer.Write(data->GetBuffer(), data->Length());
+					buffer.Seek(0, Begin);
+					buffer_data = buffer.ReadAll();
+					payload_compressed = header.Flags == ERTRC_FLAG_COMPRESSED;
+					// The cache is shared by the targets and the builds, so the entry is written aside and moved into place.
+					IO::CreateDirectoryTree(IO::Path::GetDirectory(cache_path));
+					auto temp = MakeTemporaryPath(cache_path);
+					try {
+						FileStream cache(temp, AccessWrite, CreateAlways);
+						cache.WriteArray(buffer_data);
+					} catch (...) {
+						try { IO::RemoveFile(temp); } catch (...) {}
+						throw;
+					}
+					if (!CommitTemporaryFile(temp, cache_path)) throw Exception();
+				}
+				compressed_length = buffer_data->Length();
+				// An unchanged payload keeps its time, so the resource script is not recompiled.
+				bool unchanged = false;
+				try {
+					FileStream out(output, AccessRead, OpenExisting);
+					SafePointer<DataBlock> current_data = out.ReadAll();
+					unchanged = *buffer_data == *current_data;
+				} catch (...) {}
+				if (!unchanged && !LinkFile(cache_path, output)) throw Exception();
+			} catch (...) {
+				if (!state.silent) {
+					console << TextColor(ConsoleColor::Red) << L"Failed" << TextColorDefault() << LineFeed();
+					console << TextColor(ConsoleColor::Red) << FormatString(L"Failed to compress resource file \"%0\".", r.SourcePath) << TextColorDefault() << LineFeed();
+				}
+				return ERTBT_INVALID_RESOURCE;
+			}
+		}
+		// A payload that does not shrink is stored as is, the header flags tell the runtime which one it is.
+		r.Compressed = payload_compressed;
+		r.SourcePath = output;
+		if (!state.silent) {
+			console << TextColor(ConsoleColor::Green) << (cached ? L"Cached" : L"Succeed") << TextColorDefault();
+			if (r.Compressed) {
+				console << L" (" << string(original_length) << L" -> " << string(compressed_length) << L" bytes, " <<
+					string(uint32((original_length - compressed_length) * 100 / original_length)) << L"% saved)" << LineFeed();
+			} else console << L" (stored)" << LineFeed();
+		}
+	}
+	return ERTBT_SUCCESS;
+}
+int ExtractFileFormats(Console & console)
+{
+	SafePointer<RegistryNode> node = state.project->OpenNode(L"FileFormats");
+	if (!node) return ERTBT_SUCCESS;
+	for (auto & v : node->GetSubnodes()) {
+		SafePointer<RegistryNode> sub = node->OpenNode(v);
+		if (sub->GetValueString(L"Extension").Length()) {
+			ApplicationFileFormat format;
+			format.IsProtocol = false;
+			format.Extension = sub->GetValueString(L"Extension");
+			format.Description = sub->GetValueString(L"Description");
+			format.CanCreate = sub->GetValueBoolean(L"CanCreate");
+			format.Icon = 0;
+			auto error = BuildIcon(ExpandPath(sub->GetValueString(L"Icon"), state.project_root_path), &format.Icon, console, true);
+			if (error) return error;
+			res_state.file_formats.Append(format);
+		} else if (sub->GetValueString(L"Protocol").Length()) {
+			ApplicationFileFormat format;
+			format.IsProtocol = true;
+			format.Extension = sub->GetValueString(L"Protocol");
+			format.Description = sub->GetValueString(L"Description");
+			format.CanCreate = false;
+			format.Icon = 0;
+			res_state.file_formats.Append(format);
+		} else {
+			if (!state.silent) console << TextColor(ConsoleColor::Red) << L"Unknown format definition." << TextColorDefault() << LineFeed();
+			return ERTBT_INVALID_FORMAT_ALIAS;
+		}
+	}
+	return ERTBT_SUCCESS;
+}
+
+void WriteGeneratedFile(const string & at, const string & title, MemoryStream & buffer, Console & console)
+{
+	buffer.Seek(0, Begin);
+	SafePointer<DataBlock> buffer_data = buffer.ReadAll();
+	if (!state.clean) {
+		try {
+			FileStream out(at, AccessRead, OpenExisting);
+			SafePointer<DataBlock> current_data = out.ReadAll();
+			if (*buffer_data == *current_data) return;
+		} catch (...) {}
+	}
+	if (!state.silent) console << L"Writing " << title << L" " << TextColor(ConsoleColor::Cyan) << IO::Path::GetFileName(at) << TextColorDefault() << L"...";
+	try {
+		FileStream out(at, AccessWrite, CreateAlways);
+		out.WriteArray(buffer_data);
+	} catch (...) {
+		if (!state.silent) console << TextColor(ConsoleColor::Red) << L"Failed" << TextColorDefault() << LineFeed();
+		throw;
+	}
+	if (!state.silent) console << TextColor(ConsoleColor::Green) << L"Succeed" << TextColorDefault() << LineFeed();
+}
+void GenerateApplicationManifest(const string & at, Console & console)
+{
+	MemoryStream buffer(0x1000);
+	{
+		TextWriter man(&buffer, Encoding::UTF8);
+		man.WriteLine(L"<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"yes\"?>");
+		man.WriteLine(L"<assembly xmlns=\"urn:schemas-microsoft-com:asm.v1\" manifestVersion=\"1.0\">");
+		man.WriteLine(L"<assemblyIdentity version=\"" + string(state.version_information.VersionMajor) + L"." + string(state.version_information.VersionMinor) + L"." +
+			string(state.version_information.Subversion) + L"." + string(state.version_information.Build) + L"\" processorArchitecture=\"*\" name=\"" +
+			EscapeStringXml(state.version_information.CompanyIdentifier) + L"." + EscapeStringXml(state.version_information.ApplicationIdentifier) +
+			L"\" type=\"win32\"/>");
+		man.WriteLine(L"<description>" + EscapeStringXml(state.version_information.ApplicationDescription) + L"</description>");
+		// Common Controls 6.0 support
+		man.WriteLine(L"<dependency><dependentAssembly>");
+		man.WriteLine(L"\t<assemblyIdentity type=\"win32\" name=\"Microsoft.Windows.Common-Controls\" version=\"6.0.0.0\" processorArchitecture=\"*\" "
+			L"publicKeyToken=\"6595b64144ccf1df\" language=\"*\"/>");
+		man.WriteLine(L"</dependentAssembly></dependency>");
+		// Make application DPI-aware, enable very long paths
+		man.WriteLine(L"<application xmlns=\"urn:schemas-microsoft-com:asm.v3\">");
+		if (!res_state.property_disable_hidpi) {
+			man.WriteLine(L"\t<windowsSettings>");
+			man.WriteLine(L"\t\t<dpiAware xmlns=\"http://schemas.microsoft.com/SMI/2005/WindowsSettings\">true</dpiAware>");
+			man.WriteLine(L"\t</windowsSettings>");
+		}
+		man.WriteLine(L"\t<windowsSettings xmlns:ws2=\"http://schemas.microsoft.com/SMI/2016/WindowsSettings\">");
+		man.WriteLine(L"\t\t<ws2:longPathAware>true</ws2:longPathAware>");
+		man.WriteLine(L"\t</windowsSettings>");
+		man.WriteLine(L"</application>");
+		// Windows version support
+		man.WriteLine(L"<compatibility xmlns=\"urn:schemas-microsoft-com:compatibility.v1\">");
+		man.WriteLine(L"\t<application>");
+		man.WriteLine(L"\t\t<supportedOS Id=\"{8e0f7a12-bfb3-4fe8-b9a5-48fd50a15a9a}\"/>");
+		man.WriteLine(L"\t\t<supportedOS Id=\"{1f676c76-80e1-4239-95bb-83d0f6d0da78}\"/>");
+		man.WriteLine(L"\t\t<supportedOS Id=\"{4a2f28e3-53b9-4441-ba9c-d69d4a4a6e38}\"/>");
+		man.WriteLine(L"\t\t<supportedOS Id=\"{35138b9a-5d96-4fbd-8e2d-a2440225f93a}\"/>");
+		man.WriteLine(L"\t\t<supportedOS Id=\"{e2011457-1546-43c5-a5fe-008deee3d3f0}\"/>");
+		man.WriteLine(L"\t</application>");
+		man.WriteLine(L"</compatibility>");
+		// UAC Execution level
+		man.WriteLine(L"<trustInfo xmlns=\"urn:schemas-microsoft-com:asm.v2\"><security><requestedPrivileges>");
+		if (res_state.property_needs_root_elevation) {
+			man.WriteLine(L"\t<requestedExecutionLevel level=\"requireAdministrator\" uiAccess=\"FALSE\"></requestedExecutionLevel>");
+		} else {
+			man.WriteLine(L"\t<requestedExecutionLevel level=\"asInvoker\" uiAccess=\"FALSE\"></requestedExecutionLevel>");
+		}
+		man.WriteLine(L"</requestedPrivileges></security></trustInfo>");
+		// Finilize
+		man.WriteLine(L"</assembly>");
+	}
+	WriteGeneratedFile(at, L"manifest file", buffer, console);
+}
+void GenerateResourceScript(const string & at, Console & console)
+{
+	MemoryStream buffer(0x1000);
+	TextWriter script(&buffer, Encoding::UTF16);
+	script.WriteEncodingSignature();
+	script.WriteLine(L"#include <Windows.h>");
+	script.LineFeed();
+	script.WriteLine(L"CREATEPROCESS_MANIFEST_RESOURCE_ID RT_MANIFEST \"" + EscapeStringRc(res_state.resource_manifest_file) + L"\"");
+	script.LineFeed();
+	if (res_state.icon_database.Length()) {
+		int index = 1;
+		for (auto & i : res_state.icon_database) {
+			script.WriteLine(string(index) + L" ICON \"" + EscapeStringRc(i.ConvertedPath) + L"\"");
+			index++;
+		}
+		script.LineFeed();
+	}
+	if (res_state.resources.Length()) {
+		for (auto & r : res_state.resources) {
+			auto inner_name = r.Locale.Length() ? (r.Name + L"-" + r.Locale) : r.Name;
+			script.WriteLine(inner_name + L" RCDATA \"" + EscapeStringRc(r.SourcePath) + L"\"");
+		}
+		script.LineFeed();
+	}
+	if (state.version_information.ApplicationName.Length()) {
+		auto is_library = configuration->GetValueBoolean(L"Library");
+		script.WriteLine(L"1 VERSIONINFO");
+		script.WriteLine(L"FILEVERSION " + string(state.version_information.VersionMajor) + L", " + string(state.version_information.VersionMinor) + L", " +
+			string(state.version_information.Subversion) + L", " + string(state.version_information.Build));
+		script.WriteLine(L"PRODUCTVERSION " + string(state.version_information.VersionMajor) + L", " + string(state.version_information.VersionMinor) + L", " +
+			string(state.version_information.Subversion) + L", " + string(state.version_information.Build));
+		script.WriteLine(L"FILEFLAGSMASK 0x3fL");
+		script.WriteLine(L"FILEFLAGS 0x0L");
+		script.WriteLine(L"FILEOS VOS_NT_WINDOWS32");
+		if (is_library) {
+			script.WriteLine(L"FILETYPE VFT_DLL");
+		} else {
+			script.WriteLine(L"FILETYPE VFT_APP");
+		}
+		script.WriteLine(L"FILESUBTYPE VFT2_UNKNOWN");
+		script.WriteLine(L"BEGIN");
+		script.WriteLine(L"\tBLOCK \"StringFileInfo\"");
+		script.WriteLine(L"\tBEGIN");
+		script.WriteLine(L"\t\tBLOCK \"040004b0\"");
+		script.WriteLine(L"\t\tBEGIN");
+		if (state.version_information.CompanyName.Length()) script.WriteLine(L"\t\t\tVALUE \"CompanyName\", \"" + EscapeStringRc(state.version_information.CompanyName) + L"\"");
+		script.WriteLine(L"\t\t\tVALUE \"FileDescription\", \"" + EscapeStringRc(state.version_information.ApplicationName) + L"\"");
+		script.WriteLine(L"\t\t\tVALUE \"FileVersion\", \"" + string(state.version_information.VersionMajor) + L"." + string(state.version_information.VersionMinor) + L"\"");
+		script.WriteLine(L"\t\t\tVALUE \"InternalName\", \"" + EscapeStringRc(state.version_information.InternalName) + L"\"");
+		if (state.version_information.Copyright.Length()) script.WriteLine(L"\t\t\tVALUE \"LegalCopyright\", \"" + EscapeStringRc(state.version_information.Copyright) + L"\"");
+		if (is_library) {
+			script.WriteLine(L"\t\t\tVALUE \"OriginalFilename\", \"" + EscapeStringRc(state.version_information.InternalName) + L".dll\"");
+		} else {
+			script.WriteLine(L"\t\t\tVALUE \"OriginalFilename\", \"" + EscapeStringRc(state.version_information.InternalName) + L".exe\"");
+		}
+		script.WriteLine(L"\t\t\tVALUE \"ProductName\", \"" + EscapeStringRc(state.version_information.ApplicationName) + L"\"");
+		script.WriteLine(L"\t\t\tVALUE \"ProductVersion\", \"" + string(state.version_information.VersionMajor) + L"." + string(state.version_information.VersionMinor) + L"\"");
+		script.WriteLine(L"\t\tEND");
+		script.WriteLine(L"\tEND");
+		script.WriteLine(L"\tBLOCK \"VarFileInfo\"");
+		script.WriteLine(L"\tBEGIN");
+		script.WriteLine(L"\t\tVALUE \"Translation\", 0x400, 1200");
+		script.WriteLine(L"\tEND");
+		script.WriteLine(L"END");
+	}
+	WriteGeneratedFile(at, L"resource script file", buffer, console);
+}
+void GenerateFileFormatsManifest(const string & at, Console & console)
+{
+	MemoryStream buffer(0x1000);
+	SafePointer<Registry> manifest = CreateRegistry();
+	for (auto & ff : res_state.file_formats) {
+		auto name = ff.Extension.LowerCase();
+		if (ff.IsProtocol) name += L":";
+		manifest->CreateNode(name);
+		SafePointer<RegistryNode> fn = manifest->OpenNode(name);
+		fn->CreateValue(L"Description", RegistryValueType::String);
+		fn->SetValue(L"Description", ff.Description);
+		if (!ff.IsProtocol) {
+			fn->CreateValue(L"IconIndex", RegistryValueType::Integer);
+			fn->SetValue(L"IconIndex", ff.Icon ? ff.Icon->Reference.ToInt32() : -1);
+			fn->CreateValue(L"CanCreate", RegistryValueType::Boolean);
+			fn->SetValue(L"CanCreate", ff.CanCreate);
+		}
+	}
+	RegistryToText(manifest, &buffer, Encoding::UTF8);
+	WriteGeneratedFile(at, L"file formats manifest", buffer, console);
+}
+string ComputeResourceDigest(const string & compiler, const Array<string> & arguments, ObjectArray<ResourceInputTask> & inputs)
+{
+	DynamicString line;
+	line << compiler;
+	for (auto & a : arguments) line << L"|" << a;
+	SafePointer<DataBlock> line_data = line.ToString().EncodeSequence(Encoding::UTF8, false);
+	uint64 digest = ComputeDigest(line_data->GetBuffer(), line_data->Length());
+	for (auto & i : inputs) {
+		SafePointer<DataBlock> path_data = i.Path.EncodeSequence(Encoding::UTF8, true);
+		digest = ComputeDigest(path_data->GetBuffer(), path_data->Length(), digest);
+		digest = ComputeDigest(&i.Digest, sizeof(i.Digest), digest);
+	}
+	return FormatDigest(digest);
+}
+// A digest file holds the digest of the command and all the inputs, followed by a "size time digest path"
+// record per input, so that unchanged inputs are not read again.
+string LoadResourceDigest(const string & digest_file, ObjectArray<ResourceInputTask> & inputs)
+{
+	if (state.clean) return L"";
+	try {
+		FileStream digest_stream(digest_file, AccessRead, OpenExisting);
+		TextReader reader(&digest_stream, Encoding::UTF8);
+		auto stored_digest = reader.ReadLine();
+		while (!reader.EofReached()) {
+			auto record = reader.ReadLine().Split(L' ');
+			if (record.Length() < 4) continue;
+			auto path = record[3];
+			for (int i = 4; i < record.Length(); i++) path += L" " + record[i];
+			for (auto & t : inputs) if (!t.Known && t.Path == path) {
+				t.Size = record[0].ToUInt64();
+				t.Time = record[1].ToUInt64();
+				t.Digest = record[2].ToUInt64(HexadecimalBase);
+				t.Known = true;
+				break;
+			}
+		}
+		return stored_digest;
+	} catch (...) { return L""; }
+}
+bool ScanResourceInputs(ObjectArray<ResourceInputTask> & inputs)
+{
+	SafePointer<ThreadPool> pool;
+	if (inputs.Length() > 1) try { pool = new ThreadPool; } catch (...) {}
+	if (pool) {
+		for (auto & t : inputs) pool->SubmitTask(&t);
+		pool->Wait();
+	} else for (auto & t : inputs) t.DoTask(0);
+	for (auto & t : inputs) if (!t.Succeeded) return false;
+	return true;
+}
+void SaveResourceDigest(const string & digest_file, const string & digest, ObjectArray<ResourceInputTask> & inputs)
+{
+	try {
+		FileStream digest_stream(digest_file, AccessWrite, CreateAlways);
+		TextWriter writer(&digest_stream, Encoding::UTF8);
+		writer.WriteLine(digest);
+		for (auto & t : inputs) writer.WriteLine(string(t.Size) + L" " + string(t.Time) + L" " + FormatDigest(t.Digest) + L" " + t.Path);
+	} catch (...) {}
+}
+struct StandardHandlesGuard
+{
+	~StandardHandlesGuard(void)
+	{
+		IO::SetStandardOutput(state.stdout_clone);
+		IO::SetStandardError(state.stderr_clone);
+	}
+};
+int CompileResource(const string & source, const string & object, const string & log, Console & console)
+{
+	auto oa = configuration->GetValueString(L"Compiler/OutputArgument");
+	auto cc = configuration->GetValueString(L"Compiler/Path");
+	if (!cc.Length()) {
+		if (!state.silent) console << TextColor(ConsoleColor::Red) << L"No resource compiler set for current configuration." << TextColorDefault() << LineFeed();
+		return ERTBT_INVALID_RC_SET;
+	}
+	Array<string> cc_args(0x80);
+	AppendArgumentLine(cc_args, oa, object);
+	SafePointer<RegistryNode> la = configuration->OpenNode(L"Compiler/Arguments");
+	if (la) for (auto & v : la->GetValues()) cc_args << la->GetValueString(v);
+	cc_args << source;
+	auto digest_file = object + L".digest";
+	ObjectArray<ResourceInputTask> inputs(0x40);
+	{
+		SafePointer<ResourceInputTask> task = new ResourceInputTask(source);
+		inputs.Append(task);
+		task = new ResourceInputTask(res_state.resource_manifest_file);
+		inputs.Append(task);
+		if (res_state.file_formats.Length()) {
+			task = new ResourceInputTask(res_state.resource_file_formats_file);
+			inputs.Append(task);
+		}
+		for (auto & i : res_state.icon_database) {
+			task = new ResourceInputTask(i.ConvertedPath);
+			inputs.Append(task);
+		}
+		for (auto & r : res_state.resources) {
+			task = new ResourceInputTask(r.SourcePath);
+			inputs.Append(task);
+		}
+	}
+	auto stored_digest = LoadResourceDigest(digest_file, inputs);
+	string digest;
+	if (ScanResourceInputs(inputs)) digest = ComputeResourceDigest(cc, cc_args, inputs);
+	if (!state.clean && digest.Length() && digest == stored_digest) {
+		try {
+			FileStream out(object, AccessRead, OpenExisting);
+			return ERTBT_SUCCESS;
+		} catch (...) {}
+	}
+	try { IO::RemoveFile(digest_file); } catch (...) {}
+	if (!state.silent) console << L"Compiling resource script " << TextColor(ConsoleColor::Cyan) << IO::Path::GetFileName(source) << TextColorDefault() << L"...";
+	handle log_file = IO::CreateFile(log, AccessReadWrite, CreateAlways);
+	IO::SetStandardOutput(log_file);
+	IO::SetStandardError(log_file);
+	IO::CloseHandle(log_file);
+	// The standard handles are given back to the console on every way out.
+	StandardHandlesGuard handles_guard;
+	SafePointer<Process> compiler = CreateCommandProcess(cc, &cc_args);
+	if (!compiler) {
+		if (!state.silent) {
+			console << TextColor(ConsoleColor::Red) << L"Failed" << TextColorDefault() << LineFeed();
+			console << TextColor(ConsoleColor::Red) << FormatString(L"Failed to launch the compiler (%0).", cc) << TextColorDefault() << LineFeed();
+			console << TextColor(ConsoleColor::Red) << L"You may try \"ertaconf\" to repair." << TextColorDefault() << LineFeed();
+		}
+		return ERTBT_INVALID_RC_SET;
+	}
+	compiler->Wait();
+	if (compiler->GetExitCode()) {
+		if (!state.silent) console << TextColor(ConsoleColor::Red) << L"Failed" << TextColorDefault() << LineFeed();
+		if (state.shelllog) {
+			IO::SetStandardOutput(state.stdout_clone);
+			IO::SetStandardError(state.stderr_clone);
+			Shell::OpenFile(log);
+		} else PrintError(IO::GetStandardError(), state.stderr_clone);
+		return ERTBT_RC_FAILED;
+	}
+	if (digest.Length()) SaveResourceDigest(digest_file, digest, inputs);
+	if (!state.silent) console << TextColor(ConsoleColor::Green) << L"Succeed" << TextColorDefault() << LineFeed();
+	return ERTBT_SUCCESS;
+}
+
+void GeneratePropertyList(const string & at, Console & console)
+{
+	MemoryStream buffer(0x1000);
+	TextWriter list(&buffer, Encoding::UTF8);
+	list.WriteLine(L"<?xml version=\"1.0\" encoding=\"UTF-8\"?>");
+	list.WriteLine(L"<!DOCTYPE plist PUBLIC \"-//Apple//DTD PLIST 1.0//EN\" \"http://www.apple.com/DTDs/PropertyList-1.0.dtd\">");
+	list.WriteLine(L"<plist version=\"1.0\">");
+	list.WriteLine(L"<dict>");
+	auto application_name = state.version_information.ApplicationName.Length() ? state.version_information.ApplicationName : state.version_information.InternalName;
+	list.WriteLine(L"\t<key>CFBundleName</key>");
+	list.WriteLine(L"\t<string>" + EscapeStringXml(application_name) + L"</string>");
+	list.WriteLine(L"\t<key>CFBundleDisplayName</key>");
+	list.WriteLine(L"\t<string>" + EscapeStringXml(application_name) + L"</string>");
+	list.WriteLine(L"\t<key>CFBundleIdentifier</key>");
+	list.WriteLine(L"\t<string>com." + state.version_information.CompanyIdentifier + L"." + state.version_information.ApplicationIdentifier + L"</string>");
+	list.WriteLine(L"\t<key>CFBundleVersion</key>");
+	list.WriteLine(L"\t<string>" + string(state.version_information.VersionMajor) + L"." + string(state.version_information.VersionMinor) + L"." +
+		string(state.version_information.Subversion) + L"." + string(state.version_information.Build) + L"</string>");
+	list.WriteLine(L"\t<key>CFBundleDevelopmentRegion</key>");
+	list.WriteLine(L"\t<string>en</string>");
+	list.WriteLine(L"\t<key>CFBundlePackageType</key>");
+	list.WriteLine(L"\t<string>APPL</string>");
+	list.WriteLine(L"\t<key>CFBundleExecutable</key>");
+	list.WriteLine(L"\t<string>" + EscapeStringXml(state.version_information.InternalName) + L"</string>");
+	list.WriteLine(L"\t<key>CFBundleShortVersionString</key>");
+	list.WriteLine(L"\t<string>" + string(state.version_information.VersionMajor) + L"." + string(state.version_information.VersionMinor) + L"</string>");
+	if (res_state.application_icon) {
+		list.WriteLine(L"\t<key>CFBundleIconFile</key>");
+		list.WriteLine(L"\t<string>" + res_state.application_icon->Reference + L"</string>");
+	}
+	list.WriteLine(L"\t<key>NSPrincipalClass</key>");
+	list.WriteLine(L"\t<string>NSApplication</string>");
+	list.WriteLine(L"\t<key>CFBundleInfoDictionaryVersion</key>");
+	list.WriteLine(L"\t<string>6.0</string>");
+	list.WriteLine(L"\t<key>NSHumanReadableCopyright</key>");
+	list.WriteLine(L"\t<string>" + EscapeStringXml(state.version_information.Copyright) + L"</string>");
+	list.WriteLine(L"\t<key>LSMinimumSystemVersion</key>");
+	list.WriteLine(L"\t<string>10.10</string>");
+	if (res_state.property_disable_hidpi) {
+		list.WriteLine(L"\t<key>NSHighResolutionCapable</key>");
+		list.WriteLine(L"\t<false/>");
+	} else {
+		list.WriteLine(L"\t<key>NSHighResolutionMagnifyAllowed</key>");
+		list.WriteLine(L"\t<false/>");
+		list.WriteLine(L"\t<key>NSHighResolutionCapable</key>");
+		list.WriteLine(L"\t<true/>");
+	}
+	if (res_state.property_disable_dock_icon) {
+		list.WriteLine(L"\t<key>LSUIElement</key>");
+		list.WriteLine(L"\t<true/>");
+	}
+	list.WriteLine(L"\t<key>CFBundleSupportedPlatforms</key>");
+	list.WriteLine(L"\t<array>");
+	list.WriteLine(L"\t\t<string>MacOSX</string>");
+	list.WriteLine(L"\t</array>");
+	if (res_state.file_formats.Length()) {
+		int formats = 0, protocols = 0;
+		for (auto & f : res_state.file_formats) if (f.IsProtocol) protocols++; else formats++;
+		if (formats) {
+			list.WriteLine(L"\t<key>CFBundleDocumentTypes</key>");
+			list.WriteLine(L"\t<array>");
+			for (auto & f : res_state.file_formats) if (!f.IsProtocol) {
+				list.WriteLine(L"\t\t<dict>");
+				list.WriteLine(L"\t\t\t<key>CFBundleTypeExtensions</key>");
+				list.WriteLine(L"\t\t\t<array>");
+				list.WriteLine(L"\t\t\t\t<string>" + EscapeStringXml(f.Extension) + L"</string>");
+				list.WriteLine(L"\t\t\t</array>");
+				list.WriteLine(L"\t\t\t<key>CFBundleTypeName</key>");
+				list.WriteLine(L"\t\t\t<string>" + EscapeStringXml(f.Description) + L"</string>");
+				list.WriteLine(L"\t\t\t<key>CFBundleTypeIconFile</key>");
+				list.WriteLine(L"\t\t\t<string>" + EscapeStringXml(f.Icon->Reference) + L".icns</string>");
+				list.WriteLine(L"\t\t\t<key>CFBundleTypeRole</key>");
+				list.WriteLine(L"\t\t\t<string>" + string(f.CanCreate ? L"Editor" : L"Viewer") + L"</string>");
+				list.WriteLine(L"\t\t</dict>");
+			}
+			list.WriteLine(L"\t</array>");
+		}
+		if (protocols) {
+			list.WriteLine(L"\t<key>CFBundleURLTypes</key>");
+			list.WriteLine(L"\t<array>");
+			for (auto & f : res_state.file_formats) if (f.IsProtocol) {
+				list.WriteLine(L"\t\t<dict>");
+				list.WriteLine(L"\t\t\t<key>CFBundleURLSchemes</key>");
+				list.WriteLine(L"\t\t\t<array>");
+				list.WriteLine(L"\t\t\t\t<string>" + EscapeStringXml(f.Extension) + L"</string>");
+				list.WriteLine(L"\t\t\t</array>");
+				list.WriteLine(L"\t\t\t<key>CFBundleURLName</key>");
+				list.WriteLine(L"\t\t\t<string>" + EscapeStringXml(f.Description) + L"</string>");
+				list.WriteLine(L"\t\t\t<key>CFBundleTypeRole</key>");
+				list.WriteLine(L"\t\t\t<string>Viewer</string>");
+				list.WriteLine(L"\t\t</dict>");
+			}
+			list.WriteLine(L"\t</array>");
+		}
+	}
+	if (state.version_information.AccessRequirements.CameraUsageReason.Length()) {
+		list.WriteLine(L"\t<key>NSCameraUsageDescription</key>");
+		list.WriteLine(L"\t<string>" + EscapeStringXml(state.version_information.AccessRequirements.CameraUsageReason) + L"</string>");
+	}
+	if (state.version_information.AccessRequirements.MicrophoneUsageReason.Length()) {
+		list.WriteLine(L"\t<key>NSMicrophoneUsageDescription</key>");
+		list.WriteLine(L"\t<string>" + EscapeStringXml(state.version_information.AccessRequirements.MicrophoneUsageReason) + L"</string>");
+	}
+	list.WriteLine(L"</dict>");
+	list.WriteLine(L"</plist>");
+	WriteGeneratedFile(at, L"bundle information file", buffer, console);
+}
+int PruneBundleDirectory(const string & bundle, const string & relative, Volumes::Dictionary<string, string> & files, const Array<string> & directories)
+{
+	int removed = 0;
+	auto path = relative.Length() ? (bundle + L"/" + relative) : bundle;
+	SafePointer< Array<string> > subfiles = IO::Search::GetFiles(path + L"/*");
+	SafePointer< Array<string> > subdirs = IO::Search::GetDirectories(path + L"/*");
+	for (auto & f : *subfiles) {
+		auto rel = relative.Length() ? (relative + L"/" + f) : f;
+		if (!files[rel]) { IO::RemoveFile(bundle + L"/" + rel); removed++; }
+	}
+	for (auto & d : *subdirs) {
+		auto rel = relative.Length() ? (relative + L"/" + d) : d;
+		bool keep = false;
+		for (auto & k : directories) if (k == rel) { keep = true; break; }
+		if (keep) removed += PruneBundleDirectory(bundle, rel, files, directories); else {
+			ClearDirectory(bundle + L"/" + rel);
+			IO::RemoveDirectory(bundle + L"/" + rel);
+			removed++;
+		}
+	}
+	return removed;
+}
+int BuildBundle(Console & console)
+{
+	auto bundle = IO::ExpandPath(state.project_output_root + L"/" + state.project_output_name + L".app");
+	if (!state.silent) console << L"Building Mac OS Application Bundle " << TextColor(ConsoleColor::Cyan) << IO::Path::GetFileName(bundle) << TextColorDefault() << L"...";
+	Array<string> locales = state.project->GetValueString(L"Languages").Split(L',');
+	for (int i = locales.Length() - 1; i >= 0; i--) if (!locales[i].Length()) locales.Remove(i);
+	if (!locales.Length()) locales << L"en";
+	// The bundle is synchronized with the expected contents rather than rebuilt. Contents/MacOS holds
+	// no files of ours, it is emptied as before and refilled by the linker and the attachments.
+	Volumes::Dictionary<string, string> files;
+	Array<string> file_names(0x40);
+	Array<string> directories(0x10);
+	directories << L"Contents";
+	directories << L"Contents/MacOS";
+	directories << L"Contents/Resources";
+	for (auto & l : locales) directories << L"Contents/Resources/" + l + L".lproj";
+	file_names << L"Contents/Info.plist";
+	files.Append(file_names.LastElement(), res_state.resource_manifest_file);
+	for (auto & i : res_state.icon_database) {
+		file_names << L"Contents/Resources/" + i.Reference + L".icns";
+		files.Append(file_names.LastElement(), i.ConvertedPath);
+	}
+	for (auto & r : res_state.resources) {
+		file_names << L"Contents/Resources/" + (r.Locale.Length() ? (r.Name + L"-" + r.Locale) : r.Name);
+		files.Append(file_names.LastElement(), r.SourcePath);
+	}
+	int updated = 0, removed = 0;
+	try {
+		IO::CreateDirectoryTree(bundle);
+		removed = PruneBundleDirectory(bundle, L"", files, directories);
+		for (auto & d : directories) IO::CreateDirectoryTree(bundle + L"/" + d);
+	} catch (...) {
+		if (!state.silent) console << TextColor(ConsoleColor::Red) << L"Failed" << TextColorDefault() << LineFeed();
+		return ERTBT_BUNDLE_BUILD_ERROR;
+	}
+	for (auto & f : file_names) {
+		auto & source = *files[f];
+		auto dest = bundle + L"/" + f;
+		if (IsFileUpToDate(source, dest)) continue;
+		if (!LinkFile(source, dest)) {
+			if (!state.silent) {
+				console << TextColor(ConsoleColor::Red) << L"Failed" << TextColorDefault() << LineFeed();
+				console << TextColor(ConsoleColor::Red) << FormatString(L"Failed to import resource file \"%0\".", source) << TextColorDefault() << LineFeed();
+			}
+			return ERTBT_BUNDLE_BUILD_ERROR;
+		}
+		updated++;
+	}
+	if (!state.silent) {
+		console << TextColor(ConsoleColor::Green) << L"Succeed" << TextColorDefault();
+		if (updated || removed) console << L" (" << string(updated) << L" updated, " << string(removed) << L" removed)" << LineFeed();
+		else console << L" (up to date)" << LineFeed();
+	}
+	return ERTBT_SUCCESS;
+}
+
+void GenerateLinuxApplicationManifest(const string & at, Console & console)
+{
+	MemoryStream buffer(0x1000);
+	SafePointer<Registry> manifest = CreateRegistry();
+	manifest->CreateValue(L"Name", RegistryValueType::String);
+	manifest->SetValue(L"Name", state.version_information.ApplicationName);
+	manifest->CreateValue(L"Version", RegistryValueType::String);
+	manifest->SetValue(L"Version", FormatString(L"%0.%1", state.version_information.VersionMajor, state.version_information.VersionMinor));
+	manifest->CreateValue(L"Executable", RegistryValueType::String);
+	manifest->SetValue(L"Executable", state.project_output_name);
+	if (res_state.resource_pack_file.Length()) {
+		manifest->CreateValue(L"ResourcePack", RegistryValueType::String);
+		manifest->SetValue(L"ResourcePack", IO::Path::GetFileName(res_state.resource_pack_file));
+	}
+	if (res_state.application_icon) {
+		manifest->CreateValue(L"IconFile", RegistryValueType::String);
+		manifest->SetValue(L"IconFile", res_state.application_icon->Reference);
+	}
+	for (auto & ff : res_state.file_formats) {
+		auto name = ff.Extension.LowerCase();
+		if (ff.IsProtocol) name += L":";
+		manifest->CreateNode(name);
+		SafePointer<RegistryNode> fn = manifest->OpenNode(name);
+		fn->CreateValue(L"Description", RegistryValueType::String);
+		fn->SetValue(L"Description", ff.Description);
+		if (!ff.IsProtocol) {
+			if (ff.Icon) {
+				fn->CreateValue(L"IconFile", RegistryValueType::String);
+				fn->SetValue(L"IconFile", ff.Icon->Reference);
+			}
+			fn->CreateValue(L"CanCreate", RegistryValueType::Boolean);
+			fn->SetValue(L"CanCreate", ff.CanCreate);
+		}
+	}
+	RegistryToText(manifest, &buffer, Encoding::UTF8);
+	WriteGeneratedFile(at, L"application manifest", buffer, console);
+}
+void WriteResourcePack(const string & at, string & failed)
+{
+	Array<ResourcePackEntry> entries(0x20);
+	Array<uint8> names(0x400);
+	Array<uint32> buckets(0x20);
+	uint32 bucket_count = 1;
+	while (bucket_count < uint32(res_state.resources.Length())) bucket_count <<= 1;
+	buckets.SetLength(bucket_count);
+	for (auto & b : buckets) b = ERTRP_NO_ENTRY;
+	for (auto & r : res_state.resources) {
+		SafePointer< Array<uint8> > name = GetResourceInnerName(r).EncodeSequence(Encoding::UTF8, false);
+		failed = r.SourcePath;
+		FileStream source(r.SourcePath, AccessRead, OpenExisting);
+		ResourcePackEntry entry;
+		entry.Hash = ComputeDigest(name->GetBuffer(), name->Length());
+		entry.Next = buckets[uint32(entry.Hash & (bucket_count - 1))];
+		entry.NameOffset = names.Length();
+		entry.NameLength = name->Length();
+		entry.Flags = r.Compressed ? ERTRP_FLAG_COMPRESSED : ERTRP_FLAG_STORED;
+		entry.DataOffset = 0;
+		entry.DataLength = source.Length();
+		buckets[uint32(entry.Hash & (bucket_count - 1))] = entries.Length();
+		entries << entry;
+		names.Append(*name);
+	}
+	failed = L"";
+	ResourcePackHeader header;
+	MemoryCopy(header.Signature, ERTRP_SIGNATURE, 8);
+	header.Version = ERTRP_VERSION;
+	header.PageSize = ERTRP_PAGE_SIZE;
+	header.EntryCount = entries.Length();
+	header.BucketCount = bucket_count;
+	header.BucketsOffset = sizeof(header);
+	header.EntriesOffset = header.BucketsOffset + sizeof(uint32) * bucket_count;
+	header.NamesOffset = header.EntriesOffset + sizeof(ResourcePackEntry) * entries.Length();
+	header.NamesLength = names.Length();
+	uint64 index_end = uint64(header.NamesOffset) + header.NamesLength;
+	uint64 offset = (index_end + ERTRP_PAGE_SIZE - 1) & ~uint64(ERTRP_PAGE_SIZE - 1);
+	for (auto & e : entries) {
+		e.DataOffset = offset;
+		offset = (offset + e.DataLength + ERTRP_PAGE_SIZE - 1) & ~uint64(ERTRP_PAGE_SIZE - 1);
+	}
+	Array<uint8> padding(ERTRP_PAGE_SIZE);
+	padding.SetLength(ERTRP_PAGE_SIZE);
+	ZeroMemory(padding.GetBuffer(), padding.Length());
+	// The pack is written aside and moved into place, a failed write leaves no pack at all.
+	auto temp = MakeTemporaryPath(at);
+	try {
+		FileStream pack(temp, AccessReadWrite, CreateAlways);
+		pack.Write(&header, sizeof(header));
+		pack.Write(buckets.GetBuffer(), sizeof(uint32) * buckets.Length());
+		pack.Write(entries.GetBuffer(), sizeof(ResourcePackEntry) * entries.Length());
+		pack.Write(names.GetBuffer(), names.Length());
+		offset = index_end;
+		for (int i = 0; i < entries.Length(); i++) {
+			if (entries[i].DataOffset > offset) pack.Write(padding.GetBuffer(), uint32(entries[i].DataOffset - offset));
+			failed = res_state.resources[i].SourcePath;
+			FileStream source(res_state.resources[i].SourcePath, AccessRead, OpenExisting);
+			if (source.Length() != entries[i].DataLength) throw Exception();
+			source.CopyTo(&pack);
+			offset = entries[i].DataOffset + entries[i].DataLength;
+		}
+	} catch (...) {
+		try { IO::RemoveFile(temp); } catch (...) {}
+		try { IO::RemoveFile(at); } catch (...) {}
+		throw;
+	}
+	if (!CommitTemporaryFile(temp, at)) {
+		try { IO::RemoveFile(at); } catch (...) {}
+		throw Exception();
+	}
+	failed = L"";
+}
+string GetResourcePackDigestPath(const string & at) { return IO::ExpandPath(state.project_object_path + L"/" + IO::Path::GetFileName(at) + L".digest"); }
+bool IsResourcePackUpToDate(const string & at, ObjectArray<ResourceInputTask> & inputs, string & digest)
+{
+	// The pack is keyed on the names, the flags and the contents of the resources, not on the times.
+	Array<string> layout(0x20);
+	layout << string(ERTRP_VERSION);
+	for (auto & r : res_state.resources) {
+		SafePointer<ResourceInputTask> task = new ResourceInputTask(r.SourcePath);
+		inputs.Append(task);
+		layout << GetResourceInnerName(r) + (r.Compressed ? L":c" : L":s");
+	}
+	auto stored_digest = LoadResourceDigest(GetResourcePackDigestPath(at), inputs);
+	digest = ScanResourceInputs(inputs) ? ComputeResourceDigest(L"ertrpack", layout, inputs) : string(L"");
+	if (state.clean || !digest.Length() || digest != stored_digest) return false;
+	try {
+		FileStream pack(at, AccessRead, OpenExisting);
+		return true;
+	} catch (...) { return false; }
+}
+int BuildLinuxApplicationEnvironment(Console & console)
+{
+	if (!state.silent) console << L"Building Linux Application Environment...";
+	// Published files are listed in the object directory, so the stale ones can be found without scanning the output.
+	auto published_list = IO::ExpandPath(state.project_object_path + L"/" + state.project_output_name + L".published");
+	Array<string> published(0x40), previous(0x40);
+	int updated = 0, removed = 0;
+	try {
+		FileStream list_stream(published_list, AccessRead, OpenExisting);
+		TextReader reader(&list_stream, Encoding::UTF8);
+		while (!reader.EofReached()) {
+			auto line = reader.ReadLine();
+			if (line.Length()) previous << line;
+		}
+	} catch (...) {}
+	try {
+		for (auto & i : res_state.icon_database) {
+			auto dest = state.project_output_root + L"/" + i.Reference;
+			published << i.Reference;
+			if (IsFileUpToDate(i.ConvertedPath, dest)) continue;
+			if (!LinkFile(i.ConvertedPath, dest)) throw Exception();
+			updated++;
+		}
+		if (res_state.resource_pack_file.Length()) {
+			published << IO::Path::GetFileName(res_state.resource_pack_file);
+			ObjectArray<ResourceInputTask> pack_inputs(0x20);
+			string pack_digest;
+			if (!IsResourcePackUpToDate(res_state.resource_pack_file, pack_inputs, pack_digest)) {
+				string failed;
+				try { IO::RemoveFile(GetResourcePackDigestPath(res_state.resource_pack_file)); } catch (...) {}
+				try { WriteResourcePack(res_state.resource_pack_file, failed); } catch (...) {
+					if (!state.silent) {
+						console << TextColor(ConsoleColor::Red) << L"Failed" << TextColorDefault() << LineFeed();
+						if (failed.Length()) console << TextColor(ConsoleColor::Red) << FormatString(L"Failed to import resource file \"%0\".", failed) << TextColorDefault() << LineFeed();
+					}
+					return ERTBT_BUNDLE_BUILD_ERROR;
+				}
+				if (pack_digest.Length()) SaveResourceDigest(GetResourcePackDigestPath(res_state.resource_pack_file), pack_digest, pack_inputs);
+				// Loose files left from an unpacked build would otherwise shadow the pack.
+				for (auto & r : res_state.resources) try { IO::RemoveFile(state.project_output_root + L"/" + GetResourceInnerName(r) + L".ersrc"); } catch (...) {}
+				updated++;
+			}
+		} else for (auto & r : res_state.resources) {
+			auto inner_name = GetResourceInnerName(r) + L".ersrc";
+			auto dest = state.project_output_root + L"/" + inner_name;
+			published << inner_name;
+			if (IsFileUpToDate(r.SourcePath, dest)) continue;
+			// Only the outputs of CompressResources are linked, a link to a user source would let edits in the output reach it.
+			bool build_owned = r.OriginalPath.Length() && r.OriginalPath != r.SourcePath;
+			try { IO::RemoveFile(dest); } catch (...) {}
+			if (!(build_owned ? LinkFile(r.SourcePath, dest) : CopyFile(r.SourcePath, dest))) {
+				if (!state.silent) {
+					console << TextColor(ConsoleColor::Red) << L"Failed" << TextColorDefault() << LineFeed();
+					console << TextColor(ConsoleColor::Red) << FormatString(L"Failed to import resource file \"%0\".", r.SourcePath) << TextColorDefault() << LineFeed();
+				}
+				return ERTBT_BUNDLE_BUILD_ERROR;
+			}
+			updated++;
+		}
+		for (auto & p : previous) {
+			bool stale = true;
+			for (auto & c : published) if (c == p) { stale = false; break; }
+			if (stale) try {
+				IO::RemoveFile(state.project_output_root + L"/" + p);
+				removed++;
+			} catch (...) {}
+		}
+		bool list_changed = previous.Length() != published.Length();
+		if (!list_changed) for (int i = 0; i < published.Length(); i++) if (published[i] != previous[i]) { list_changed = true; break; }
+		if (list_changed) {
+			FileStream list_stream(published_list, AccessWrite, CreateAlways);
+			TextWriter writer(&list_stream, Encoding::UTF8);
+			for (auto & p : published) writer.WriteLine(p);
+		}
+	} catch (...) {
+		if (!state.silent) console << TextColor(ConsoleColor::Red) << L"Failed" << TextColorDefault() << LineFeed();
+		return ERTBT_BUNDLE_BUILD_ERROR;
+	}
+	if (!state.silent) {
+		console << TextColor(ConsoleColor::Green) << L"Succeed" << TextColorDefault();
+		if (updated || removed) console << L" (" << string(updated) << L" updated, " << string(removed) << L" removed)" << LineFeed();
+		else console << L" (up to date)" << LineFeed();
+	}
+	return ERTBT_SUCCESS;
+}
+
+uint64 GetResourceFileLength(const string & path)
+{
+	try {
+		FileStream file(path, AccessRead, OpenExisting);
+		return file.Length();
+	} catch (...) { return 0; }
+}
+int ReportResources(Console & console)
+{
+	// Page-in estimates assume 4 KiB pages. Loose files and bundle entries are opened and mapped one by one,
+	// the Windows resource section and the Linux resource pack are mapped as a whole.
+	const uint64 page_size = ERTRP_PAGE_SIZE;
+	bool packed = res_state.mode == ResourceMode::Linux && res_state.resource_pack_file.Length();
+	string mode, placement;
+	if (res_state.mode == ResourceMode::Windows) { mode = L"windows"; placement = L"embedded"; }
+	else if (res_state.mode == ResourceMode::MacOSX) { mode = L"macosx"; placement = L"bundle"; }
+	else { mode = L"linux"; placement = packed ? L"packed" : L"loose"; }
+	uint64 total_original = 0, total_stored = 0, total_pages = 0, section_length = 0;
+	int file_opens = 0;
+	Array<uint64> original_sizes(0x20), stored_sizes(0x20), pages(0x20);
+	for (auto & r : res_state.resources) {
+		uint64 original = GetResourceFileLength(r.OriginalPath.Length() ? r.OriginalPath : r.SourcePath);
+		uint64 stored = r.Compression.Length() ? GetResourceFileLength(r.SourcePath) : original;
+		original_sizes << original;
+		stored_sizes << stored;
+		pages << (stored + page_size - 1) / page_size;
+		total_original += original;
+		total_stored += stored;
+		section_length += stored;
+	}
+	Array<string> icon_frames(0x10);
+	Array<uint64> icon_sizes(0x10);
+	for (auto & i : res_state.icon_database) {
+		DynamicString frames;
+		try {
+			FileStream icon(i.ConvertedPath, AccessRead, OpenExisting);
+			SafePointer<Codec::Image> image = Codec::DecodeImage(&icon);
+			if (image) for (int j = 0; j < image->Frames.Length(); j++) {
+				auto frame = image->Frames.ElementAt(j);
+				if (frames.Length()) frames << L" ";
+				frames << string(frame->GetWidth()) << L"x" << string(frame->GetHeight());
+			}
+		} catch (...) {}
+		icon_frames << frames.ToString();
+		icon_sizes << GetResourceFileLength(i.ConvertedPath);
+		if (res_state.mode == ResourceMode::Windows) section_length += icon_sizes.LastElement();
+	}
+	if (res_state.mode == ResourceMode::Windows) {
+		total_pages = (section_length + page_size - 1) / page_size;
+	} else if (packed) {
+		total_pages = (GetResourceFileLength(res_state.resource_pack_file) + page_size - 1) / page_size;
+		file_opens = 1;
+	} else {
+		for (auto & p : pages) total_pages += p;
+		file_opens = res_state.resources.Length();
+	}
+	if (state.resource_report && !state.silent) {
+		console << LineFeed() << L"Resource report (" << mode << L"):" << LineFeed();
+		for (int i = 0; i < res_state.resources.Length(); i++) {
+			auto & r = res_state.resources[i];
+			console << L"  " << TextColor(ConsoleColor::Cyan) << GetResourceInnerName(r) << TextColorDefault() << L": " <<
+				string(original_sizes[i]) << L" -> " << string(stored_sizes[i]) << L" bytes, " <<
+				(r.Compressed ? r.CompressionName : string(L"stored")) << L", " << placement << L", " << string(pages[i]) << L" pages" << LineFeed();
+		}
+		for (int i = 0; i < res_state.icon_database.Length(); i++) {
+			auto & icon = res_state.icon_database[i];
+			console << L"  " << TextColor(ConsoleColor::Cyan) << IO::Path::GetFileName(icon.ConvertedPath) << TextColorDefault() << L": " <<
+				string(icon_sizes[i]) << L" bytes, frames " << (icon_frames[i].Length() ? icon_frames[i] : string(L"unknown")) << LineFeed();
+		}
+		console << L"  Total: " << string(total_original) << L" -> " << string(total_stored) << L" bytes, " << string(file_opens) << L" file opens, " <<
+			string(total_pages) << L" pages (" << string(total_pages * page_size / 1024) << L" KiB) to page in." << LineFeed() << LineFeed();
+	}
+	if (state.resource_report_json.Length()) {
+		try {
+			FileStream report_stream(state.resource_report_json, AccessWrite, CreateAlways);
+			TextWriter report(&report_stream, Encoding::UTF8);
+			report.WriteLine(L"{");
+			report.WriteLine(L"\t\"mode\": \"" + mode + L"\",");
+			report.WriteLine(L"\t\"page_size\": " + string(page_size) + L",");
+			report.WriteLine(L"\t\"resources\": [");
+			for (int i = 0; i < res_state.resources.Length(); i++) {
+				auto & r = res_state.resources[i];
+				report.WriteLine(L"\t\t{\"name\": \"" + EscapeStringJson(r.Name) + L"\", \"locale\": \"" + EscapeStringJson(r.Locale) +
+					L"\", \"original_size\": " + string(original_sizes[i]) + L", \"stored_size\": " + string(stored_sizes[i]) +
+					L", \"compression\": \"" + EscapeStringJson(r.Compressed ? r.CompressionName : string(L"")) + L"\", \"placement\": \"" + placement +
+					L"\", \"pages\": " + string(pages[i]) + (i < res_state.resources.Length() - 1 ? L"}," : L"}"));
+			}
+			report.WriteLine(L"\t],");
+			report.WriteLine(L"\t\"icons\": [");
+			for (int i = 0; i < res_state.icon_database.Length(); i++) {
+				auto & icon = res_state.icon_database[i];
+				DynamicString frames;
+				for (auto & f : icon_frames[i].Split(L' ')) if (f.Length()) {
+					auto wh = f.Split(L'x');
+					if (frames.Length()) frames << L", ";
+					frames << L"{\"width\": " << wh[0] << L", \"height\": " << wh[1] << L"}";
+				}
+				report.WriteLine(L"\t\t{\"file\": \"" + EscapeStringJson(IO::Path::GetFileName(icon.ConvertedPath)) + L"\", \"reference\": \"" +
+					EscapeStringJson(icon.Reference) + L"\", \"size\": " + string(icon_sizes[i]) + L", \"frames\": [" + frames.ToString() +
+					(i < res_state.icon_database.Length() - 1 ? L"]}," : L"]}"));
+			}
+			report.WriteLine(L"\t],");
+			report.WriteLine(L"\t\"total\": {\"original_size\": " + string(total_original) + L", \"stored_size\": " + string(total_stored) +
+				L", \"file_opens\": " + string(file_opens) + L", \"pages\": " + string(total_pages) + L"}");
+			report.WriteLine(L"}");
+		} catch (...) {
+			if (!state.silent) console << TextColor(ConsoleColor::Red) << FormatString(L"Failed to write the resource report \"%0\".", state.resource_report_json) << TextColorDefault() << LineFeed();
+			return ERTBT_OVERWRITE_FAILED;
+		}
+	}
+	return ERTBT_SUCCESS;
+}
+int GenerateResources(Console & console)
+{
+	configuration = local_config->OpenNode(L"Resource");
+	if (!configuration) {
+		if (!state.silent) console << TextColor(ConsoleColor::Red) << L"Resource tool configuration is invalid." << TextColorDefault() << LineFeed();
+		return ERTBT_INVALID_CONFIGURATION;
+	}
+	if (configuration->GetValueBoolean(L"Windows")) res_state.mode = ResourceMode::Windows;
+	else if (configuration->GetValueBoolean(L"MacOSX")) res_state.mode = ResourceMode::MacOSX;
+	else if (configuration->GetValueBoolean(L"Linux")) res_state.mode = ResourceMode::Linux;
+	else {
+		if (!state.silent) console << TextColor(ConsoleColor::Red) << L"Resource tool configuration is invalid." << TextColorDefault() << LineFeed();
+		return ERTBT_INVALID_CONFIGURATION;
+	}
+	res_state.property_disable_hidpi = state.project->GetValueBoolean(L"NoHiDPI");
+	res_state.property_disable_dock_icon = state.project->GetValueBoolean(L"NoDockIcon");
+	res_state.property_needs_root_elevation = state.project->GetValueBoolean(L"NeedsElevation");
+	res_state.property_pack_resources = state.project->GetValueBoolean(L"PackResources");
+	auto app_icon_path = state.project->GetValueString(L"ApplicationIcon");
+	if (app_icon_path.Length()) {
+		app_icon_path = ExpandPath(app_icon_path, state.project_root_path);
+		auto error = BuildIcon(app_icon_path, &res_state.application_icon, console);
+		if (error) return error;
+	}
+	auto error = ExtractResources(console);
+	if (error) return error;
+	error = CompressResources(console);
+	if (error) return error;
+	error = ExtractFileFormats(console);
+	if (error) return error;
+	error = ConvertIcons(console);
+	if (error) return error;
+	if (res_state.mode == ResourceMode::Windows) {
+		res_state.resource_manifest_file = IO::ExpandPath(state.project_object_path + L"/" + state.project_output_name + L".manifest");
+		res_state.resource_script_file = IO::ExpandPath(state.project_object_path + L"/" + state.project_output_name + L".rc");
+		res_state.resource_object_file = IO::ExpandPath(state.project_object_path + L"/" + state.project_output_name + L".res");
+		res_state.resource_object_file_log = IO::ExpandPath(state.project_object_path + L"/" + state.project_output_name + L".rc.log");
+		res_state.resource_file_formats_file = IO::ExpandPath(state.project_object_path + L"/" + state.project_output_name + L".formats.ini");
+		GenerateApplicationManifest(res_state.resource_manifest_file, console);
+		GenerateResourceScript(res_state.resource_script_file, console);
+		if (res_state.file_formats.Length()) GenerateFileFormatsManifest(res_state.resource_file_formats_file, console);
+		error = CompileResource(res_state.resource_script_file, res_state.resource_object_file, res_state.resource_object_file_log, console);
+	} else if (res_state.mode == ResourceMode::MacOSX) {
+		res_state.resource_manifest_file = IO::ExpandPath(state.project_object_path + L"/" + state.project_output_name + L".plist");
+		GeneratePropertyList(res_state.resource_manifest_file, console);
+		error = BuildBundle(console);
+	} else if (res_state.mode == ResourceMode::Linux) {
+		res_state.resource_manifest_file = IO::ExpandPath(state.project_object_path + L"/" + state.project_output_name + L".app.ini");
+		if (res_state.property_pack_resources) res_state.resource_pack_file = IO::ExpandPath(state.project_output_root + L"/" + state.project_output_name + L".erpack");
+		GenerateLinuxApplicationManifest(res_state.resource_manifest_file, console);
+		error = BuildLinuxApplicationEnvironment(console);
+	}
+	if (!error && (state.resource_report || state.resource_report_json.Length())) error = ReportResources(console);
+	return error;
+}
\ No newline at end of file
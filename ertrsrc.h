@@ -0,0 +1,7 @@
+﻿#pragma once
+
+#include "ertcom.h"
+
+bool IsValidResourceName(const string & value);
+int RegisterResource(const string & name, const string & path, Console & console);
+int GenerateResources(Console & console);
@@ -0,0 +1,35 @@
+﻿#include "ertutil.h"
+
+uint64 ComputeDigest(const void * data, int length, uint64 digest)
+{
+	auto bytes = reinterpret_cast<const uint8 *>(data);
+	for (int i = 0; i < length; i++) { digest ^= bytes[i]; digest *= 0x100000001B3; }
+	return digest;
+}
+uint64 ComputeDigest(const string & text, uint64 digest)
+{
+	SafePointer<DataBlock> data = text.EncodeSequence(Encoding::UTF32, false);
+	return ComputeDigest(data->GetBuffer(), data->Length(), digest);
+}
+string FormatDigest(uint64 digest) { return string(digest, L"0123456789abcdef", 16); }
+string EscapeStringJson(const string & input)
+{
+	DynamicString result;
+	for (int i = 0; i < input.Length(); i++) {
+		auto c = input[i];
+		if (c == L'\\') {
+			result += L"\\\\";
+		} else if (c == L'\"') {
+			result += L"\\\"";
+		} else if (c == L'\n') {
+			result += L"\\n";
+		} else if (c == L'\r') {
+			result += L"\\r";
+		} else if (c == L'\t') {
+			result += L"\\t";
+		} else if (c < 0x20) {
+			result += L"\\u" + string(uint(c), HexadecimalBase, 4);
+		} else result += c;
+	}
+	return result.ToString();
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <EngineRuntime.h>
+
+using namespace Engine;
+
+// FNV-1a, shared by every cache and manifest of the builder tools and the interface compiler.
+const uint64 DigestSeed = 0xCBF29CE484222325;
+
+uint64 ComputeDigest(const void * data, int length, uint64 digest = DigestSeed);
+uint64 ComputeDigest(const string & text, uint64 digest = DigestSeed);
+string FormatDigest(uint64 digest);
+string EscapeStringJson(const string & input);
@@ -1,5 +1,7 @@
 ﻿#include <EngineRuntime.h>
 
+#include "../ertpix.h"
+
 using namespace Engine;
 using namespace Engine::Streaming;
 using namespace Engine::Codec;
@@ -36,6 +38,8 @@ struct {
 	bool silent = false;
 	bool nologo = false;
 	bool decompose = false;
+	int resize_width = 0;
+	int resize_height = 0;
 	Array<string> input = Array<string>(0x20);
 	string output;
 	string codec;
@@ -92,6 +96,27 @@ bool ParseCommandLine(Console & console)
 						console << TextColor(ConsoleColor::Red) << L"Not enough command line arguments." << TextColorDefault() << LineFeed();
 						return false;
 					}
+				} else if (o == L'r') {
+					if (state.resize_width) {
+						console << TextColor(ConsoleColor::Red) << L"Size redefinition." << TextColorDefault() << LineFeed();
+						return false;
+					}
+					if (i < args->Length() - 1) {
+						i++;
+						auto size = args->ElementAt(i).LowerCase().Split(L'x');
+						try {
+							if (size.Length() > 2) throw Exception();
+							state.resize_width = size[0].ToUInt32();
+							state.resize_height = size.Length() > 1 ? size[1].ToUInt32() : state.resize_width;
+						} catch (...) { state.resize_width = state.resize_height = 0; }
+						if (state.resize_width <= 0 || state.resize_height <= 0) {
+							console << TextColor(ConsoleColor::Red) << L"Invalid image size." << TextColorDefault() << LineFeed();
+							return false;
+						}
+					} else {
+						console << TextColor(ConsoleColor::Red) << L"Not enough command line arguments." << TextColorDefault() << LineFeed();
+						return false;
+					}
 				} else if (o == L'o') {
 					if (state.output.Length()) {
 						console << TextColor(ConsoleColor::Red) << L"Output path redefinition." << TextColorDefault() << LineFeed();
@@ -141,7 +166,7 @@ int Main(void)
 	if (!state.input.Length()) {
 		if (!state.silent) {
 			console << L"Command line syntax:" << LineFeed();
-			console << L"  " << ENGINE_VI_APPSYSNAME << L" <input> :NSdfo" << LineFeed();
+			console << L"  " << ENGINE_VI_APPSYSNAME << L" <input> :NSdfor" << LineFeed();
 			console << L"Where" << LineFeed();
 			console << L"  input - files (or file filters) to convert," << LineFeed();
 			console << L"  :N    - use no logo mode - don't print application logo," << LineFeed();
@@ -158,7 +183,9 @@ int Main(void)
 			console << L"            cur  - Windows Cursor," << LineFeed();
 			console << L"            icns - Apple Icon," << LineFeed();
 			console << L"            eiwv - Engine Image Volume," << LineFeed();
-			console << L"  :o    - overrides the name of the output file or directory." << LineFeed();
+			console << L"  :o    - overrides the name of the output file or directory," << LineFeed();
+			console << L"  :r    - resample all the frames to the size given as the next argument," << LineFeed();
+			console << L"            either \"<size>\" or \"<width>x<height>\"." << LineFeed();
 			console << LineFeed();
 		}
 	} else {
@@ -199,7 +226,13 @@ int Main(void)
 							try { IO::GetFileType(out); serial++; } catch (...) { state.output = out; break; }
 						}
 					}
-					for (int j = 0; j < decoded->Frames.Length(); j++) image->Frames.Append(decoded->Frames.ElementAt(j));
+					for (int j = 0; j < decoded->Frames.Length(); j++) {
+						if (state.resize_width) {
+							SafePointer<Frame> resized = CreateResampledFrame(decoded->Frames.ElementAt(j), state.resize_width, state.resize_height,
+								PixelFilter::Lanczos);
+							image->Frames.Append(resized);
+						} else image->Frames.Append(decoded->Frames.ElementAt(j));
+					}
 					if (!state.silent) console << TextColor(ConsoleColor::Green) << L"Succeed." << TextColorDefault() << LineFeed();
 				}
 			}
@@ -0,0 +1,175 @@
+﻿#include <EngineRuntime.h>
+
+#include "../ertpix.h"
+
+using namespace Engine;
+using namespace Engine::Codec;
+using namespace Engine::IO;
+using namespace Engine::IO::ConsoleControl;
+
+struct {
+	bool silent = false;
+	bool nologo = false;
+	int width = 3840;
+	int height = 2160;
+	int iterations = 10;
+} state;
+
+enum class BenchmarkEffect { Grayscale, BlindGrayscale, Tint, Opacity, Premultiply };
+
+bool ParseCommandLine(Console & console)
+{
+	SafePointer< Array<string> > args = GetCommandLine();
+	int index = 0;
+	for (int i = 1; i < args->Length(); i++) {
+		auto & a = args->ElementAt(i);
+		if (a[0] == L'-' || a[0] == L':') {
+			for (int j = 1; j < a.Length(); j++) {
+				auto o = a[j];
+				if (o == L'N') {
+					state.nologo = true;
+				} else if (o == L'S') {
+					state.silent = true;
+				} else {
+					console << TextColor(ConsoleColor::Red) << L"Invalid command line option." << TextColorDefault() << LineFeed();
+					return false;
+				}
+			}
+		} else {
+			int value;
+			try { value = a.ToUInt32(); } catch (...) { value = 0; }
+			if (value <= 0 || index > 2) {
+				console << TextColor(ConsoleColor::Red) << L"Invalid command line argument." << TextColorDefault() << LineFeed();
+				return false;
+			}
+			if (index == 0) state.width = value;
+			else if (index == 1) state.height = value;
+			else state.iterations = value;
+			index++;
+		}
+	}
+	return true;
+}
+uint8 ReferenceMulDiv255(uint32 a, uint32 b) { uint32 v = a * b + 128; return uint8((v + (v >> 8)) >> 8); }
+void ReferenceEffect(Frame * frame, BenchmarkEffect effect)
+{
+	for (int y = 0; y < frame->GetHeight(); y++) for (int x = 0; x < frame->GetWidth(); x++) {
+		Color clr = frame->GetPixel(x, y);
+		if (effect == BenchmarkEffect::Grayscale) {
+			uint8 v = uint8((uint32(clr.r) + uint32(clr.g) + uint32(clr.b)) / 3);
+			clr.r = clr.g = clr.b = v;
+		} else if (effect == BenchmarkEffect::BlindGrayscale) {
+			uint8 v = 64 + uint8((uint32(clr.r) + uint32(clr.g) + uint32(clr.b)) / 6);
+			clr.r = clr.g = clr.b = v;
+		} else if (effect == BenchmarkEffect::Tint) {
+			clr.r = ReferenceMulDiv255(clr.r, 255);
+			clr.g = ReferenceMulDiv255(clr.g, 128);
+			clr.b = ReferenceMulDiv255(clr.b, 64);
+			clr.a = ReferenceMulDiv255(clr.a, 200);
+		} else if (effect == BenchmarkEffect::Opacity) {
+			clr.a = ReferenceMulDiv255(clr.a, 128);
+		} else if (effect == BenchmarkEffect::Premultiply) {
+			clr.r = ReferenceMulDiv255(clr.r, clr.a);
+			clr.g = ReferenceMulDiv255(clr.g, clr.a);
+			clr.b = ReferenceMulDiv255(clr.b, clr.a);
+		}
+		frame->SetPixel(x, y, clr);
+	}
+}
+void KernelEffect(Frame * frame, BenchmarkEffect effect)
+{
+	PixelBuffer buffer;
+	GetFramePixels(frame, buffer);
+	if (effect == BenchmarkEffect::Grayscale) PixelGrayscale(buffer);
+	else if (effect == BenchmarkEffect::BlindGrayscale) PixelBlindGrayscale(buffer);
+	else if (effect == BenchmarkEffect::Tint) PixelTint(buffer, 255, 128, 64, 200);
+	else if (effect == BenchmarkEffect::Opacity) PixelOpacity(buffer, 128, false);
+	else if (effect == BenchmarkEffect::Premultiply) PixelPremultiply(buffer);
+}
+Frame * CreateSampleFrame(void)
+{
+	SafePointer<Frame> frame = new Frame(state.width, state.height, -1, PixelFormat::R8G8B8A8, AlphaMode::Normal, ScanOrigin::BottomUp);
+	uint32 seed = 0x12345678;
+	for (int y = 0; y < frame->GetHeight(); y++) {
+		auto row = frame->GetData() + intptr(y) * frame->GetScanLineLength();
+		for (int x = 0; x < frame->GetWidth() * 4; x++) {
+			seed = seed * 1664525 + 1013904223;
+			row[x] = uint8(seed >> 24);
+		}
+	}
+	frame->Retain();
+	return frame;
+}
+bool CompareFrames(Frame * a, Frame * b)
+{
+	for (int y = 0; y < a->GetHeight(); y++) {
+		if (MemoryCompare(a->GetData() + intptr(y) * a->GetScanLineLength(), b->GetData() + intptr(y) * b->GetScanLineLength(), a->GetWidth() * 4)) return false;
+	}
+	return true;
+}
+string FormatTime(uint32 time, int iterations)
+{
+	uint64 micro = uint64(time) * 1000 / iterations;
+	return string(uint32(micro / 1000)) + L"." + string(uint32(micro % 1000), DecimalBase, 3) + L" ms";
+}
+bool RunBenchmark(Frame * sample, BenchmarkEffect effect, const string & name, Console & console)
+{
+	uint32 time_reference = 0, time_scalar = 0, time_vector = 0;
+	SafePointer<Frame> reference, scalar, vector;
+	for (int i = 0; i < state.iterations; i++) {
+		reference = sample->ConvertFormat(PixelFormat::R8G8B8A8, AlphaMode::Normal, ScanOrigin::BottomUp);
+		scalar = sample->ConvertFormat(PixelFormat::R8G8B8A8, AlphaMode::Normal, ScanOrigin::BottomUp);
+		vector = sample->ConvertFormat(PixelFormat::R8G8B8A8, AlphaMode::Normal, ScanOrigin::BottomUp);
+		auto start = GetTimerValue();
+		ReferenceEffect(reference, effect);
+		time_reference += GetTimerValue() - start;
+		SetPixelKernelLevel(PixelKernelLevel::Scalar);
+		start = GetTimerValue();
+		KernelEffect(scalar, effect);
+		time_scalar += GetTimerValue() - start;
+		SetPixelKernelLevel(GetPixelKernelMaximalLevel());
+		start = GetTimerValue();
+		KernelEffect(vector, effect);
+		time_vector += GetTimerValue() - start;
+	}
+	bool match = CompareFrames(reference, scalar) && CompareFrames(reference, vector);
+	if (!state.silent) {
+		console << name << L":" << LineFeed();
+		console << L"  per-pixel: " << FormatTime(time_reference, state.iterations) << LineFeed();
+		console << L"  scalar:    " << FormatTime(time_scalar, state.iterations) << LineFeed();
+		console << L"  " << GetPixelKernelLevelName(GetPixelKernelMaximalLevel()) << L":" << string(L' ', max(10 - GetPixelKernelLevelName(GetPixelKernelMaximalLevel()).Length(), 1)) << FormatTime(time_vector, state.iterations) << LineFeed();
+		if (match) console << TextColor(ConsoleColor::Green) << L"  Outputs are identical." << TextColorDefault() << LineFeed();
+		else console << TextColor(ConsoleColor::Red) << L"  Outputs differ." << TextColorDefault() << LineFeed();
+	}
+	return match;
+}
+
+int Main(void)
+{
+	Console console;
+	if (!ParseCommandLine(console)) return 2;
+	if (!state.nologo && !state.silent) {
+		console << ENGINE_VI_APPNAME << LineFeed();
+		console << L"Copyright " << string(ENGINE_VI_COPYRIGHT).Replace(L'\xA9', L"(C)") << LineFeed();
+		console << L"Version " << ENGINE_VI_APPVERSION << L", build " << ENGINE_VI_BUILD << LineFeed() << LineFeed();
+		console << L"Command line syntax:" << LineFeed();
+		console << L"  " << ENGINE_VI_APPSYSNAME << L" [width [height [iterations]]] :NS" << LineFeed() << LineFeed();
+	}
+	try {
+		SafePointer<Frame> sample = CreateSampleFrame();
+		if (!state.silent) {
+			console << L"Frame " << string(state.width) << L"x" << string(state.height) << L", " << string(state.iterations) << L" iterations." << LineFeed();
+			console << L"Kernel level available: " << GetPixelKernelLevelName(GetPixelKernelMaximalLevel()) << L"." << LineFeed() << LineFeed();
+		}
+		bool match = true;
+		match &= RunBenchmark(sample, BenchmarkEffect::Grayscale, L"Grayscale", console);
+		match &= RunBenchmark(sample, BenchmarkEffect::BlindGrayscale, L"BlindGrayscale", console);
+		match &= RunBenchmark(sample, BenchmarkEffect::Tint, L"Tint", console);
+		match &= RunBenchmark(sample, BenchmarkEffect::Opacity, L"Opacity", console);
+		match &= RunBenchmark(sample, BenchmarkEffect::Premultiply, L"Premultiply", console);
+		return match ? 0 : 1;
+	} catch (...) {
+		if (!state.silent) console << TextColor(ConsoleColor::Red) << L"Benchmark failed." << TextColorDefault() << LineFeed();
+		return 1;
+	}
+}
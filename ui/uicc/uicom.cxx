@@ -0,0 +1,722 @@
+#include "uicom.h"
+
+#include "../../ertutil.h"
+
+using namespace Engine::Streaming;
+using namespace Engine::IO;
+using namespace Engine::IO::ConsoleControl;
+
+namespace Engine
+{
+	namespace UI
+	{
+		namespace Markup
+		{
+			class Verifyier : public IResourceResolver, public Format::IMissingStylesReporter
+			{
+			public:
+				Array<string> & Messages;
+				bool OK;
+				Verifyier(Array<string> & messages) : Messages(messages), OK(true) {}
+
+				virtual Graphics::IBitmap * GetTexture(const string & Name) override
+				{
+					Messages << L"Warning: referenced but not defined texture object: \"" + Name + L"\".";
+					OK = false;
+					return 0;
+				}
+				virtual Graphics::IFont * GetFont(const string & Name) override
+				{
+					Messages << L"Warning: referenced but not defined font object: \"" + Name + L"\".";
+					OK = false;
+					return 0;
+				}
+				virtual Template::Shape * GetApplication(const string & Name) override
+				{
+					Messages << L"Warning: referenced but not defined application object: \"" + Name + L"\".";
+					OK = false;
+					return 0;
+				}
+				virtual Template::ControlTemplate * GetDialog(const string & Name) override
+				{
+					Messages << L"Warning: referenced but not defined dialog object: \"" + Name + L"\".";
+					OK = false;
+					return 0;
+				}
+				virtual Template::ControlReflectedBase * CreateCustomTemplate(const string & Class) override { return 0; }
+				virtual void ReportStyleIsMissing(const string & Name, const string & Class) override
+				{
+					Messages << L"Warning: referenced but not defined style object: \"" + Name + L"\" for control class \"" + Class + L"\".";
+					OK = false;
+				}
+			};
+
+			class SourceIndex
+			{
+				bool _loaded;
+				bool _tried;
+			public:
+				string Text;
+				Array<int> LineStarts;
+
+				SourceIndex(void) : _loaded(false), _tried(false), LineStarts(0x100) {}
+				bool Load(const string & file)
+				{
+					if (_tried) return _loaded;
+					_tried = true;
+					try {
+						FileStream src(file, AccessRead, OpenExisting);
+						TextReader reader(&src);
+						DynamicString result;
+						while (!reader.EofReached()) {
+							auto line = reader.ReadLine();
+							LineStarts << result.Length();
+							if (line.Length() > 1 && line[0] == L'#' && line[1] == L'#') result << L'\n';
+							else result << line << L'\n';
+						}
+						Text = result.ToString();
+						_loaded = true;
+					} catch (...) {}
+					return _loaded;
+				}
+				int GetLine(int offs) const
+				{
+					int lo = 0, hi = LineStarts.Length() - 1;
+					while (lo < hi) {
+						int mid = (lo + hi + 1) / 2;
+						if (LineStarts[mid] <= offs) lo = mid; else hi = mid - 1;
+					}
+					return lo + 1;
+				}
+				int GetColumn(int offs) const
+				{
+					int lb = LineStarts[GetLine(offs) - 1];
+					return Text.Fragment(lb, offs - lb).GetEncodedLength(Encoding::UTF32) + 1;
+				}
+			};
+
+			void PrintError(Console & console, SourceIndex & source, const string & file, int offs, int len, bool warning = false)
+			{
+				try {
+					if (!source.Load(file) || offs >= source.Text.Length()) return;
+					auto & text = source.Text;
+					int ln = source.GetLine(offs);
+					int lb = source.LineStarts[ln - 1];
+					int le = offs;
+					while (lb < offs && (text[lb] == L' ' || text[lb] == L'\t')) lb++;
+					while (le < text.Length() - 1 && (text[le + 1] >= 32 || text[le + 1] == L'\t')) le++;
+					string line = text.Fragment(lb, le - lb + 1).Replace(L'\t', L' ');
+					string pref = string(warning ? L"Warning on " : L"Error on ") + L"line #" + string(ln) + L": ";
+					console << pref;
+					console << (warning ? TextColor(ConsoleColor::Yellow) : TextColor(ConsoleColor::Red));
+					console << line << TextColorDefault() << LineFeed();
+					console << string(L' ', line.Fragment(0, offs - lb).GetEncodedLength(Encoding::UTF32) + pref.Length());
+					console << (warning ? TextColor(ConsoleColor::DarkYellow) : TextColor(ConsoleColor::DarkRed));
+					console << L"^";
+					if (len > 1) console << string(L'~', line.Fragment(offs - lb, len).GetEncodedLength(Encoding::UTF32) - 1);
+					console << TextColorDefault() << LineFeed() << LineFeed();
+				} catch (...) {}
+			}
+			void PrintJsonDiagnostic(Console & console, SourceIndex & source, const string & file, int offs, int len, bool warning, const string & message)
+			{
+				int line = 0, column = 0;
+				if (offs >= 0 && source.Load(file) && offs < source.Text.Length()) {
+					line = source.GetLine(offs);
+					column = source.GetColumn(offs);
+				}
+				console << L"{\"file\":\"" << EscapeStringJson(file) << L"\",\"line\":" << string(line) << L",\"column\":" << string(column) <<
+					L",\"length\":" << string(max(len, 0)) << L",\"severity\":\"" << (warning ? L"warning" : L"error") <<
+					L"\",\"message\":\"" << EscapeStringJson(message) << L"\"}" << LineFeed();
+			}
+			string GetErrorDescription(ErrorClass error, const string & file)
+			{
+				if (error == ErrorClass::ObjectRedifinition) return L"Object redifinition.";
+				else if (error == ErrorClass::SourceAccess) return L"Failed to open a file: \"" + file + L"\".";
+				else if (error == ErrorClass::UndefinedObject) return L"Undefined object.";
+				else if (error == ErrorClass::UnexpectedLexem) return L"Another token expected.";
+				else if (error == ErrorClass::NumericConstantTypeMismatch) return L"Numeric type mismatch.";
+				else if (error == ErrorClass::MainInvalidToken) return L"Invalid token.";
+				else if (error == ErrorClass::InvalidSystemColor) return L"Unknown system color identifier.";
+				else if (error == ErrorClass::InvalidProperty) return L"Unknown property identifier.";
+				else if (error == ErrorClass::InvalidLocaleIdentifier) return L"Invalid locale identifier.";
+				else if (error == ErrorClass::InvalidEffect) return L"Unknown effect identifier.";
+				else if (error == ErrorClass::InvalidConstantType) return L"Invalid constant type.";
+				else if (error == ErrorClass::IncludedInvalidToken) return L"Invalid token in file \"" + file + L"\".";
+				else return L"Unknown error.";
+			}
+			string GetWarningDescription(WarningClass warning, const string & info)
+			{
+				if (warning == WarningClass::InvalidControlParent) {
+					Array<string> cls = info.Split(L',');
+					return L"Control with class \"" + cls[0] + L"\" is not assumed to be a child of \"" + cls[1] + L"\".";
+				} else if (warning == WarningClass::UnknownPlatformName) {
+					return L"Unknown platform name: " + info + L".";
+				} else return L"Unknown warning.";
+			}
+
+			void CompilationWarnings::ReportWarning(WarningClass warning_class, int warning_pos, int warning_length, const string & warning_info)
+			{ classes << warning_class; positions << warning_pos; lengths << warning_length; infos << warning_info; }
+
+			class PreloadDecodeTask : public IDispatchTask
+			{
+			public:
+				string Path;
+				string System;
+				string Digest;
+				SafePointer<Format::InterfaceTemplateImage> Image;
+
+				PreloadDecodeTask(const string & path, const string & system) : Path(path), System(system) {}
+				virtual void DoTask(IDispatchQueue * queue) override
+				{
+					try {
+						SafePointer<DataBlock> data;
+						{
+							FileStream preload_file(Path, AccessRead, OpenExisting);
+							data = preload_file.ReadAll();
+						}
+						Digest = GetDataDigest(data);
+						MemoryStream preload_stream(data->GetBuffer(), data->Length());
+						Image = new Format::InterfaceTemplateImage(&preload_stream, L"", System, 0.0);
+					} catch (...) { Image.SetReference(0); }
+				}
+			};
+
+			PreloadedInterface::PreloadedInterface(void) : Dependencies(0x10), Loaded(false) {}
+			PreloadedInterface::~PreloadedInterface(void) {}
+
+			CompilationTask::CompilationTask(const CompilerOptions & options, const string & input, const string & output, ICompilationCache * cache) :
+				Options(options), InputFile(input), OutputFile(output), System(options.specialize_system.Length() ? options.specialize_system : GetCompilerSystemName()), Pooled(false), Error(ErrorClass::UnknownError), ErrorOffset(-1), ErrorLength(-1),
+				Verified(false), VerificationOK(false), VerificationUndone(false), VerificationMessages(0x10), PlainSize(0), CompressedSize(0), DecodeTime(0), Encoded(false), Unchanged(false), Dependencies(0x10), Time(0)
+			{
+				Cache.SetRetain(cache);
+				Warnings = new CompilationWarnings;
+			}
+			CompilationTask::~CompilationTask(void) {}
+			void CompilationTask::DoTask(IDispatchQueue * queue) { Compile(); }
+			void CompilationTask::Compile(void)
+			{
+				uint32 time = GetTimerValue();
+				SafePointer<Format::InterfaceTemplateImage> image =
+					CompileInterface(InputFile, Options.style_output, ErrorOffset, ErrorLength, Error, ErrorFile, Options.include_path, Warnings, Cache, &Dependencies, !Pooled);
+				if (Error != ErrorClass::OK || (Options.warnings_as_errors && Warnings->classes.Length())) {
+					if (Options.dependency_manifest) try { IO::RemoveFile(GetDependencyManifestPath(OutputFile)); } catch (...) {}
+					return;
+				}
+				if (Options.specialize_system.Length() || Options.specialize_scale) image->Specialize(L"", System, Options.specialize_scale);
+				if (Options.atlas) BuildTextureAtlases(image, Atlas);
+				if (!Options.no_verification) try {
+					Verifyier ver(VerificationMessages);
+					InterfaceTemplate interface;
+					SafePointer<Format::InterfaceTemplateImage> clone = image->Clone();
+					clone->Specialize(L"", System, 0.0);
+					if (Options.preload_list.Length()) {
+						// The preloads are normally decoded once per batch by RunCompilationTasks.
+						if (!Preloaded) Preloaded = LoadPreloadedInterface(Options.preload_list, System);
+						if (!Preloaded->Loaded) {
+							VerificationUndone = true;
+							ver.OK = false;
+							VerificationMessages << L"Failed to load preloadable asset. Check the command line.";
+						}
+						clone->Compile(interface, Preloaded->Interface, 0, &ver, &ver);
+					} else clone->Compile(interface, 0, &ver, &ver);
+					if (Preloaded) for (auto & p : Preloaded->Dependencies) {
+						bool known = false;
+						for (auto & d : Dependencies) if (d.Path == p.Path) { known = true; break; }
+						if (!known) Dependencies << p;
+					}
+					VerificationOK = ver.OK;
+					Verified = true;
+				} catch (...) {}
+				try {
+					if (Options.no_colors) {
+						for (int i = 0; i < image->Assets.Length(); i++) for (int j = 0; j < image->Assets[i].Colors.Length(); j++) image->Assets[i].Colors[j].Name = L"";
+					}
+					uint32 flags = Options.no_strings ? 0 : Format::EncodeFlags::EncodeStringNames;
+					SafePointer<DataBlock> data;
+					if (Options.compress) {
+						data = EncodeCompressedImage(image, flags, &PlainSize, &DecodeTime);
+						CompressedSize = data->Length();
+					} else {
+						MemoryStream encoded(0x10000);
+						image->Encode(&encoded, flags);
+						encoded.Seek(0, Begin);
+						data = encoded.ReadAll();
+					}
+					try {
+						FileStream current(OutputFile, AccessRead, OpenExisting);
+						if (current.Length() == data->Length()) {
+							SafePointer<DataBlock> current_data = current.ReadAll();
+							Unchanged = *current_data == *data;
+						}
+					} catch (...) {}
+					if (!Unchanged) {
+						FileStream Dest(OutputFile, AccessReadWrite, CreateAlways);
+						Dest.Write(data->GetBuffer(), data->Length());
+					}
+					Encoded = true;
+					// A failed verification must be reported again on the next run, so the output is not recorded as up to date.
+					if (Options.dependency_manifest) {
+						if (Options.no_verification || VerificationOK) WriteDependencyManifest(OutputFile, Options, data, Dependencies);
+						else try { IO::RemoveFile(GetDependencyManifestPath(OutputFile)); } catch (...) {}
+					}
+				} catch (...) {}
+				Time = GetTimerValue() - time;
+			}
+			int CompilationTask::Report(Console & console)
+			{
+				auto & state = Options;
+				if (!state.silent) {
+					console << L"Compiling " << TextColor(ConsoleColor::Cyan) << IO::Path::GetFileName(InputFile) << TextColorDefault() << L"...";
+				}
+				SourceIndex source;
+				if (Error != ErrorClass::OK) {
+					if (state.json_diagnostics) PrintJsonDiagnostic(console, source, InputFile, ErrorOffset, ErrorLength, false, GetErrorDescription(Error, ErrorFile));
+					if (!state.silent) {
+						console << TextColor(ConsoleColor::Red) << L"Failed" << LineFeed() << LineFeed();
+						console << TextColorDefault();
+						if (ErrorOffset >= 0) PrintError(console, source, InputFile, ErrorOffset, ErrorLength);
+						console << TextColor(ConsoleColor::Red) << GetErrorDescription(Error, ErrorFile) << TextColorDefault() << LineFeed() << LineFeed();
+					}
+					return 1;
+				}
+				if (!state.silent) console << TextColor(ConsoleColor::Green) << L"Succeed" << TextColorDefault() << LineFeed();
+				for (int i = 0; i < Warnings->classes.Length(); i++) {
+					if (state.json_diagnostics && !state.supress_warnings) {
+						PrintJsonDiagnostic(console, source, InputFile, Warnings->positions[i], Warnings->lengths[i], !state.warnings_as_errors,
+							GetWarningDescription(Warnings->classes[i], Warnings->infos[i]));
+					}
+					if (!state.silent && !state.supress_warnings) {
+						if (Warnings->positions[i] >= 0) PrintError(console, source, InputFile, Warnings->positions[i], Warnings->lengths[i], true);
+						if (state.warnings_as_errors) console << TextColor(ConsoleColor::Red);
+						else console << TextColor(ConsoleColor::Yellow);
+						console << GetWarningDescription(Warnings->classes[i], Warnings->infos[i]);
+						console << TextColorDefault() << LineFeed();
+					}
+					if (state.warnings_as_errors) return 1;
+				}
+				if (!state.silent && state.atlas) {
+					console << L"Packing textures...";
+					if (Atlas.AtlasCount) {
+						console << TextColor(ConsoleColor::Green) << L"Succeed" << TextColorDefault() << LineFeed();
+						console << string(Atlas.TexturesPacked) << L" textures packed into " << string(Atlas.AtlasCount) << L" atlases, ";
+						console << TextColor(ConsoleColor::Magenta) << string(Atlas.AtlasArea ? uint32(Atlas.SpriteArea * 100 / Atlas.AtlasArea) : 0U) << L"%" << TextColorDefault();
+						console << L" of the atlas area is used, " << string(Atlas.TexturesSkipped) << L" textures left as is." << LineFeed();
+					} else console << TextColor(ConsoleColor::Yellow) << L"Nothing to pack" << TextColorDefault() << LineFeed();
+				}
+				if (!state.silent) console << L"Verifying the image...";
+				if (state.no_verification) {
+					if (!state.silent) console << TextColor(ConsoleColor::Yellow) << L"Skipped" << TextColorDefault() << LineFeed();
+				} else if (Verified) {
+					if (!state.silent && !state.supress_warnings && VerificationMessages.Length()) {
+						console << LineFeed() << TextColor(ConsoleColor::Blue);
+						for (auto & m : VerificationMessages) console << m << LineFeed();
+						console << TextColorDefault();
+					}
+					if (VerificationOK) {
+						if (!state.silent) console << TextColor(ConsoleColor::Green) << L"Succeed" << TextColorDefault() << LineFeed();
+					} else {
+						if (!VerificationUndone && !state.silent) {
+							if (state.supress_warnings) {
+								console << TextColor(ConsoleColor::Yellow) << L"Reference issues found" << TextColorDefault() << LineFeed();
+							} else {
+								console << TextColor(ConsoleColor::Yellow) << L"All the reference issues may result in errors. Source verification is recommended.";
+								console << TextColorDefault() << LineFeed() << LineFeed();
+							}
+						}
+					}
+				} else if (!state.silent) console << TextColor(ConsoleColor::Red) << L"Failed to compile the image" << TextColorDefault() << LineFeed() << LineFeed();
+				if (!state.silent) console << L"Encoding " << TextColor(ConsoleColor::Cyan) << IO::Path::GetFileName(OutputFile) << TextColorDefault() << L"...";
+				if (!Encoded) {
+					if (!state.silent) console << TextColor(ConsoleColor::Red) << L"Failed" << TextColorDefault() << LineFeed() << LineFeed();
+					return 1;
+				}
+				if (!state.silent) {
+					if (Unchanged) console << TextColor(ConsoleColor::Green) << L"Unchanged" << TextColorDefault() << LineFeed();
+					else console << TextColor(ConsoleColor::Green) << L"Succeed" << TextColorDefault() << LineFeed();
+					if (state.compress) {
+						console << L"Compressed " << string(PlainSize) << L" bytes into " << string(CompressedSize) << L" bytes (" <<
+							TextColor(ConsoleColor::Magenta) << string(PlainSize ? uint32(uint64(CompressedSize) * 100 / PlainSize) : 0U) << L"%" << TextColorDefault() <<
+							L"), unpacking takes " << TextColor(ConsoleColor::Magenta) << string(DecodeTime) << TextColorDefault() << L" ms." << LineFeed();
+					}
+				}
+				if (!state.silent && state.time_estimate) {
+					console << LineFeed() << L"Done in " << TextColor(ConsoleColor::Magenta) << string(Time) << TextColorDefault() << L" ms." << LineFeed() << LineFeed();
+				}
+				return 0;
+			}
+
+			string GetCompilerSystemName(void)
+			{
+				#ifdef ENGINE_WINDOWS
+				return L"Windows";
+				#endif
+				#ifdef ENGINE_MACOSX
+				return L"MacOSX";
+				#endif
+				#ifdef ENGINE_LINUX
+				return L"Linux";
+				#endif
+			}
+			void LoadCompilerConfiguration(CompilerOptions & options)
+			{
+				try {
+					FileStream reg_src(IO::Path::GetDirectory(IO::GetExecutablePath()) + L"/uicc.ini", AccessRead, OpenExisting);
+					SafePointer<Storage::Registry> reg = Storage::CompileTextRegistry(&reg_src);
+					if (!reg) {
+						FileStream reg_binary_src(IO::Path::GetDirectory(IO::GetExecutablePath()) + L"/uicc.ecs", AccessRead, OpenExisting);
+						reg = Storage::LoadRegistry(&reg_binary_src);
+					}
+					if (reg) {
+						options.include_path = IO::ExpandPath(IO::Path::GetDirectory(IO::GetExecutablePath()) + L"/" + reg->GetValueString(L"Include"));
+						auto token_cache = reg->GetValueString(L"TokenCache");
+						if (token_cache.Length() && !options.token_cache.Length()) options.token_cache = IO::ExpandPath(IO::Path::GetDirectory(IO::GetExecutablePath()) + L"/" + token_cache);
+						SafePointer<Storage::RegistryNode> subordering_node = reg->OpenNode(L"Subordering");
+						if (subordering_node) SetSuborderingTable(subordering_node);
+					}
+				} catch (...) {}
+			}
+			bool ParseCompilerArguments(const Array<string> & args, int from, CompilerOptions & options, Array<string> * inputs, Array<string> * outputs, Console & console)
+			{
+				int i = from;
+				while (i < args.Length()) {
+					auto & cmd = args[i];
+					if (cmd[0] == L':' || cmd[0] == L'-') {
+						i++;
+						for (int j = 1; j < cmd.Length(); j++) {
+							auto arg = cmd[j];
+							if (arg == L'J') {
+								options.json_diagnostics = true;
+							} else if (arg == L'S') {
+								options.silent = true;
+							} else if (arg == L'V') {
+								options.no_verification = true;
+							} else if (arg == L'W') {
+								options.warnings_as_errors = true;
+							} else if (arg == L'a') {
+								options.atlas = true;
+							} else if (arg == L'c') {
+								options.no_colors = true;
+							} else if (arg == L'k') {
+								if (i < args.Length()) {
+									options.token_cache = IO::ExpandPath(args[i]);
+									i++;
+								} else {
+									console << TextColor(ConsoleColor::Yellow) << L"Invalid command line: argument expected." << TextColorDefault() << LineFeed();
+									return false;
+								}
+							} else if (arg == L'l') {
+								options.style_output = true;
+							} else if (arg == L'o') {
+								if (i < args.Length()) {
+									if (options.output_file.Length()) {
+										console << TextColor(ConsoleColor::Yellow) << FormatString(L"Output name redefinition.", args[i]) << TextColorDefault() << LineFeed();
+										return false;
+									}
+									options.output_file = IO::ExpandPath(args[i]);
+									i++;
+								} else {
+									console << TextColor(ConsoleColor::Yellow) << L"Invalid command line: argument expected." << TextColorDefault() << LineFeed();
+									return false;
+								}
+							} else if (arg == L'p') {
+								if (i < args.Length()) {
+									options.preload_list << IO::ExpandPath(args[i]);
+									i++;
+								} else {
+									console << TextColor(ConsoleColor::Yellow) << L"Invalid command line: argument expected." << TextColorDefault() << LineFeed();
+									return false;
+								}
+							} else if (arg == L'd') {
+								options.dependency_manifest = true;
+							} else if (arg == L'j') {
+								if (i < args.Length()) {
+									try { options.threads = args[i].ToUInt32(); } catch (...) {
+										console << TextColor(ConsoleColor::Yellow) << L"Invalid command line: thread count expected." << TextColorDefault() << LineFeed();
+										return false;
+									}
+									i++;
+								} else {
+									console << TextColor(ConsoleColor::Yellow) << L"Invalid command line: argument expected." << TextColorDefault() << LineFeed();
+									return false;
+								}
+							} else if (arg == L'r') {
+								if (i < args.Length() && inputs && outputs) {
+									auto file = IO::ExpandPath(args[i]);
+									if (!LoadResponseFile(file, *inputs, *outputs)) {
+										console << TextColor(ConsoleColor::Yellow) << FormatString(L"Failed to read the response file \"%0\".", file) << TextColorDefault() << LineFeed();
+										return false;
+									}
+									i++;
+								} else {
+									console << TextColor(ConsoleColor::Yellow) << L"Invalid command line: argument expected." << TextColorDefault() << LineFeed();
+									return false;
+								}
+							} else if (arg == L's') {
+								options.no_strings = true;
+							} else if (arg == L't') {
+								options.time_estimate = true;
+							} else if (arg == L'x') {
+								if (i < args.Length()) {
+									try { options.specialize_scale = args[i].ToDouble(); } catch (...) { options.specialize_scale = -1.0; }
+									if (options.specialize_scale <= 0.0) {
+										console << TextColor(ConsoleColor::Yellow) << L"Invalid command line: positive scale expected." << TextColorDefault() << LineFeed();
+										return false;
+									}
+									i++;
+								} else {
+									console << TextColor(ConsoleColor::Yellow) << L"Invalid command line: argument expected." << TextColorDefault() << LineFeed();
+									return false;
+								}
+							} else if (arg == L'y') {
+								if (i < args.Length()) {
+									options.specialize_system = args[i];
+									i++;
+								} else {
+									console << TextColor(ConsoleColor::Yellow) << L"Invalid command line: argument expected." << TextColorDefault() << LineFeed();
+									return false;
+								}
+							} else if (arg == L'z') {
+								options.compress = true;
+							} else if (arg == L'w') {
+								options.supress_warnings = true;
+							} else {
+								console << TextColor(ConsoleColor::Yellow) << FormatString(L"Command line argument \"%0\" is invalid.", string(arg, 1)) << TextColorDefault() << LineFeed();
+								return false;
+							}
+						}
+					} else {
+						if (!inputs || !outputs) {
+							console << TextColor(ConsoleColor::Yellow) << FormatString(L"Unexpected input file argument \"%0\".", cmd) << TextColorDefault() << LineFeed();
+							return false;
+						}
+						inputs->Append(IO::ExpandPath(cmd));
+						outputs->Append(L"");
+						i++;
+					}
+				}
+				return true;
+			}
+			string ExpandResponsePath(const string & path, const string & root)
+			{
+				// Absolute paths are taken as is, relative ones are resolved against the response file.
+				if (path[0] == L'/' || path[0] == L'\\' || (path[0] && path[1] == L':')) return IO::ExpandPath(path);
+				else return IO::ExpandPath(root + L"/" + path);
+			}
+			bool LoadResponseFile(const string & file, Array<string> & inputs, Array<string> & outputs)
+			{
+				try {
+					auto root = IO::Path::GetDirectory(file);
+					FileStream stream(file, AccessRead, OpenExisting);
+					TextReader reader(&stream);
+					while (!reader.EofReached()) {
+						auto line = reader.ReadLine();
+						int lb = 0;
+						while (lb < line.Length() && (line[lb] == L' ' || line[lb] == L'\t')) lb++;
+						if (lb == line.Length() || line[lb] == L'#') continue;
+						auto split = line.FindFirst(L"->");
+						string input = split >= 0 ? line.Fragment(lb, split - lb) : line.Fragment(lb, -1);
+						string output = split >= 0 ? line.Fragment(split + 2, -1) : string(L"");
+						while (input.Length() && (input[input.Length() - 1] == L' ' || input[input.Length() - 1] == L'\t')) input = input.Fragment(0, input.Length() - 1);
+						while (output.Length() && (output[0] == L' ' || output[0] == L'\t')) output = output.Fragment(1, -1);
+						while (output.Length() && (output[output.Length() - 1] == L' ' || output[output.Length() - 1] == L'\t')) output = output.Fragment(0, output.Length() - 1);
+						if (!input.Length()) return false;
+						inputs << ExpandResponsePath(input, root);
+						outputs << (output.Length() ? ExpandResponsePath(output, root) : string(L""));
+					}
+				} catch (...) { return false; }
+				return true;
+			}
+			PreloadedInterface * LoadPreloadedInterface(const Array<string> & preload_list, const string & system, ThreadPool * pool)
+			{
+				SafePointer<PreloadedInterface> result = new PreloadedInterface;
+				ObjectArray<PreloadDecodeTask> preloads(0x10);
+				for (auto & p : preload_list) {
+					SafePointer<PreloadDecodeTask> preload = new PreloadDecodeTask(p, system);
+					preloads.Append(preload);
+				}
+				if (pool && preloads.Length() > 1) {
+					for (auto & p : preloads) pool->SubmitTask(&p);
+					pool->Wait();
+				} else for (auto & p : preloads) p.DoTask(0);
+				result->Loaded = true;
+				for (auto & p : preloads) {
+					try {
+						if (!p.Image) throw Exception();
+						p.Image->Compile(result->Interface);
+						SourceDependency dependency;
+						dependency.Path = p.Path;
+						dependency.Digest = p.Digest;
+						result->Dependencies << dependency;
+					} catch (...) { result->Loaded = false; }
+				}
+				result->Retain();
+				return result;
+			}
+			string GetDefaultOutputFile(const string & input, bool style_output)
+			{
+				if (style_output) return IO::Path::GetDirectory(input) + string(IO::PathDirectorySeparator) + IO::Path::GetFileNameWithoutExtension(input) + L".estl";
+				else return IO::Path::GetDirectory(input) + string(IO::PathDirectorySeparator) + IO::Path::GetFileNameWithoutExtension(input) + L".eui";
+			}
+			DataBlock * EncodeCompressedImage(Format::InterfaceTemplateImage * image, uint32 flags, uint32 * plain_size, uint32 * decode_time)
+			{
+				Storage::MethodChain chain = 0;
+				chain = chain.Append(Storage::CompressionMethod::LempelZivWelch);
+				chain = chain.Append(Storage::CompressionMethod::Huffman);
+				if (plain_size) {
+					MemoryStream plain(0x10000);
+					image->Encode(&plain, flags);
+					*plain_size = uint32(plain.Length());
+				}
+				Array<int> textures(0x40);
+				ObjectArray<DataBlock> texture_data(0x40);
+				Volumes::Dictionary<int, int> known;
+				for (int i = 0; i < image->Assets.Length(); i++) for (int j = 0; j < image->Assets[i].Textures.Length(); j++) {
+					auto id = image->Assets[i].Textures[j].ImageID;
+					if (known[id] || !image->Textures[id]) continue;
+					known.Append(id, 1);
+					MemoryStream texture(0x10000);
+					Codec::EncodeImage(&texture, *image->Textures[id], Codec::ImageFormatEngine);
+					texture.Seek(0, Begin);
+					SafePointer<DataBlock> data = texture.ReadAll();
+					textures << id;
+					texture_data.Append(data);
+				}
+				for (auto & id : textures) image->Textures.Remove(id);
+				MemoryStream metadata(0x10000);
+				image->Encode(&metadata, flags);
+				metadata.Seek(0, Begin);
+				// The interface goes first, then every texture as a separate entry to be unpacked on demand.
+				MemoryStream container(0x10000);
+				{
+					SafePointer<Storage::NewArchive> archive = Storage::CreateArchive(&container, 1 + textures.Length(), 0);
+					archive->SetFileType(1, L"Interface");
+					archive->SetFileData(1, &metadata, chain, Storage::CompressionQuality::Variative, 0, 0x100000);
+					for (int i = 0; i < textures.Length(); i++) {
+						MemoryStream texture(texture_data[i].GetBuffer(), texture_data[i].Length());
+						archive->SetFileType(i + 2, L"Texture");
+						archive->SetFileID(i + 2, textures[i]);
+						archive->SetFileData(i + 2, &texture, chain, Storage::CompressionQuality::Variative, 0, 0x10000);
+					}
+					archive->Finalize();
+				}
+				container.Seek(0, Begin);
+				SafePointer<DataBlock> result = container.ReadAll();
+				if (decode_time) {
+					uint32 time = GetTimerValue();
+					MemoryStream check(result->GetBuffer(), result->Length());
+					SafePointer<Storage::Archive> unpacker = Storage::OpenArchive(&check);
+					if (!unpacker) throw Exception();
+					for (Storage::ArchiveFile file = 1; file <= unpacker->GetFileCount(); file++) {
+						SafePointer<Stream> stream = unpacker->QueryFileStream(file);
+						SafePointer<DataBlock> data = stream->ReadAll();
+					}
+					*decode_time = GetTimerValue() - time;
+				}
+				result->Retain();
+				return result;
+			}
+			string GetDataDigest(const DataBlock * data)
+			{
+				return FormatDigest(ComputeDigest(data->GetBuffer(), data->Length()));
+			}
+			string GetFileDigest(const string & file)
+			{
+				try {
+					FileStream stream(file, AccessRead, OpenExisting);
+					SafePointer<DataBlock> data = stream.ReadAll();
+					return GetDataDigest(data);
+				} catch (...) { return L""; }
+			}
+			string GetDependencyManifestPath(const string & output) { return output + L".dep"; }
+			// Bump whenever the compiler or the output format changes, so the outputs of older compilers are rebuilt.
+			const uint32 CompilerSignatureVersion = 1;
+			string GetOptionsSignature(const CompilerOptions & options)
+			{
+				DynamicString signature;
+				signature << string(CompilerSignatureVersion) << L"|";
+				if (options.atlas) signature << L"a";
+				if (options.compress) signature << L"z";
+				if (options.style_output) signature << L"l";
+				if (options.no_colors) signature << L"c";
+				if (options.no_strings) signature << L"s";
+				if (options.no_verification) signature << L"V";
+				if (options.warnings_as_errors) signature << L"W";
+				if (options.supress_warnings) signature << L"w";
+				signature << L"|" << options.include_path;
+				for (auto & p : options.preload_list) signature << L"|" << p;
+				if (options.specialize_system.Length() || options.specialize_scale) signature << L"|" << options.specialize_system << L"|" << string(options.specialize_scale);
+				return signature.ToString();
+			}
+			bool WriteDependencyManifest(const string & output, const CompilerOptions & options, const DataBlock * encoded, const Array<SourceDependency> & dependencies)
+			{
+				try {
+					SafePointer<Storage::Registry> manifest = Storage::CreateRegistry();
+					manifest->CreateValue(L"Signature", Storage::RegistryValueType::String);
+					manifest->SetValue(L"Signature", GetOptionsSignature(options));
+					manifest->CreateValue(L"Output", Storage::RegistryValueType::String);
+					manifest->SetValue(L"Output", GetDataDigest(encoded));
+					for (int i = 0; i < dependencies.Length(); i++) {
+						auto & digest = dependencies[i].Digest;
+						if (!digest.Length()) throw Exception();
+						string name = string(uint32(i + 1), L"0123456789", 9);
+						manifest->CreateNode(name);
+						SafePointer<Storage::RegistryNode> node = manifest->OpenNode(name);
+						node->CreateValue(L"Path", Storage::RegistryValueType::String);
+						node->SetValue(L"Path", dependencies[i].Path);
+						node->CreateValue(L"Digest", Storage::RegistryValueType::String);
+						node->SetValue(L"Digest", digest);
+					}
+					FileStream stream(GetDependencyManifestPath(output), AccessReadWrite, CreateAlways);
+					manifest->Save(&stream);
+				} catch (...) {
+					try { IO::RemoveFile(GetDependencyManifestPath(output)); } catch (...) {}
+					return false;
+				}
+				return true;
+			}
+			bool CheckDependencyManifest(const string & output, const CompilerOptions & options)
+			{
+				try {
+					FileStream stream(GetDependencyManifestPath(output), AccessRead, OpenExisting);
+					SafePointer<Storage::Registry> manifest = Storage::LoadRegistry(&stream);
+					if (!manifest) return false;
+					if (manifest->GetValueString(L"Signature") != GetOptionsSignature(options)) return false;
+					if (manifest->GetValueString(L"Output") != GetFileDigest(output)) return false;
+					auto & nodes = manifest->GetSubnodes();
+					if (!nodes.Length()) return false;
+					for (auto & n : nodes) {
+						SafePointer<Storage::RegistryNode> node = manifest->OpenNode(n);
+						if (node->GetValueString(L"Digest") != GetFileDigest(node->GetValueString(L"Path"))) return false;
+					}
+				} catch (...) { return false; }
+				return true;
+			}
+			int RunCompilationTasks(ObjectArray<CompilationTask> & tasks, Console & console, ThreadPool * pool)
+			{
+				CurrentScaleFactor = 1.0;
+				Assembly::CurrentLocale = L"en";
+				// Tasks with the same system and preload list share one decoded and merged preload set.
+				for (int i = 0; i < tasks.Length(); i++) {
+					auto & task = tasks[i];
+					if (task.Preloaded || task.Options.no_verification || !task.Options.preload_list.Length()) continue;
+					for (int j = 0; j < i; j++) {
+						auto & prev = tasks[j];
+						if (!prev.Preloaded || prev.System != task.System) continue;
+						if (prev.Options.preload_list.Length() != task.Options.preload_list.Length()) continue;
+						bool same = true;
+						for (int k = 0; k < task.Options.preload_list.Length(); k++) if (prev.Options.preload_list[k] != task.Options.preload_list[k]) { same = false; break; }
+						if (same) { task.Preloaded = prev.Preloaded; break; }
+					}
+					if (!task.Preloaded) task.Preloaded = LoadPreloadedInterface(task.Options.preload_list, task.System, pool);
+				}
+				if (pool && tasks.Length() > 1) {
+					for (auto & t : tasks) { t.Pooled = true; pool->SubmitTask(&t); }
+					pool->Wait();
+				} else for (auto & t : tasks) t.Compile();
+				int result = 0;
+				for (auto & t : tasks) if (t.Report(console)) result = 1;
+				return result;
+			}
+		}
+	}
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <EngineRuntime.h>
+
+#include "uiml.h"
+
+namespace Engine
+{
+	namespace UI
+	{
+		namespace Markup
+		{
+			struct CompilerOptions
+			{
+				bool silent = false;
+				bool warnings_as_errors = false;
+				bool supress_warnings = false;
+				bool no_strings = false;
+				bool no_colors = false;
+				bool style_output = false;
+				bool time_estimate = false;
+				bool dependency_manifest = false;
+				bool atlas = false;
+				bool compress = false;
+				bool no_verification = false;
+				bool json_diagnostics = false;
+				int threads = 0;
+				double specialize_scale = 0.0;
+				string specialize_system;
+				string include_path;
+				string token_cache;
+				string output_file;
+				Array<string> preload_list = Array<string>(0x10);
+			};
+			class CompilationWarnings : public IWarningReporter
+			{
+			public:
+				Array<WarningClass> classes = Array<WarningClass>(0x10);
+				Array<int> positions = Array<int>(0x10);
+				Array<int> lengths = Array<int>(0x10);
+				Array<string> infos = Array<string>(0x10);
+				virtual void ReportWarning(WarningClass warning_class, int warning_pos, int warning_length, const string & warning_info) override;
+			};
+			class PreloadedInterface : public Object
+			{
+			public:
+				InterfaceTemplate Interface;
+				Array<SourceDependency> Dependencies;
+				bool Loaded;
+
+				PreloadedInterface(void);
+				virtual ~PreloadedInterface(void) override;
+			};
+			class CompilationTask : public IDispatchTask
+			{
+			public:
+				CompilerOptions Options;
+				string InputFile;
+				string OutputFile;
+				string System;
+				SafePointer<ICompilationCache> Cache;
+				SafePointer<PreloadedInterface> Preloaded;
+				bool Pooled;
+
+				ErrorClass Error;
+				int ErrorOffset;
+				int ErrorLength;
+				string ErrorFile;
+				SafePointer<CompilationWarnings> Warnings;
+				bool Verified;
+				bool VerificationOK;
+				bool VerificationUndone;
+				Array<string> VerificationMessages;
+				TextureAtlasStatistics Atlas;
+				uint32 PlainSize;
+				uint32 CompressedSize;
+				uint32 DecodeTime;
+				bool Encoded;
+				bool Unchanged;
+				Array<SourceDependency> Dependencies;
+				uint32 Time;
+
+				CompilationTask(const CompilerOptions & options, const string & input, const string & output, ICompilationCache * cache);
+				virtual ~CompilationTask(void) override;
+				virtual void DoTask(IDispatchQueue * queue) override;
+				void Compile(void);
+				int Report(IO::Console & console);
+			};
+
+			string GetCompilerSystemName(void);
+			void LoadCompilerConfiguration(CompilerOptions & options);
+			bool ParseCompilerArguments(const Array<string> & args, int from, CompilerOptions & options, Array<string> * inputs, Array<string> * outputs, IO::Console & console);
+			bool LoadResponseFile(const string & file, Array<string> & inputs, Array<string> & outputs);
+			DataBlock * EncodeCompressedImage(Format::InterfaceTemplateImage * image, uint32 flags, uint32 * plain_size, uint32 * decode_time);
+			PreloadedInterface * LoadPreloadedInterface(const Array<string> & preload_list, const string & system, ThreadPool * pool = 0);
+			string GetDefaultOutputFile(const string & input, bool style_output);
+			string GetDataDigest(const DataBlock * data);
+			string GetFileDigest(const string & file);
+			string GetDependencyManifestPath(const string & output);
+			string GetOptionsSignature(const CompilerOptions & options);
+			bool WriteDependencyManifest(const string & output, const CompilerOptions & options, const DataBlock * encoded, const Array<SourceDependency> & dependencies);
+			bool CheckDependencyManifest(const string & output, const CompilerOptions & options);
+			int RunCompilationTasks(ObjectArray<CompilationTask> & tasks, IO::Console & console, ThreadPool * pool = 0);
+		}
+	}
+}
@@ -3,9 +3,13 @@
 #include <UserInterface/InterfaceFormat.h>
 #include <UserInterface/ControlClasses.h>
 #include <Miscellaneous/DynamicString.h>
+#include <Interfaces/Threading.h>
 
 #include <Syntax/Tokenization.h>
 
+#include "../../ertpix.h"
+#include "../../ertutil.h"
+
 using namespace Engine::Streaming;
 using namespace Engine::Syntax;
 
@@ -89,39 +93,38 @@ namespace Engine
 				int OuterPosition;
 				InnerSourceWrongIncludeException(int pos) : OuterPosition(pos) {}
 			};
-			class SyntaxException : public Exception
-			{
-			public:
-				int StartPosition;
-				int EndPosition;
-				ErrorClass LocalError;
-				SyntaxException(const string & Code, Array<Token> & Tokens, int Position, ErrorClass cls)
-				{
-					StartPosition = Tokens[Position].SourcePosition;
-					LocalError = cls;
-					int NextToken = Position;
-					while (NextToken < Tokens.Length() && Tokens[NextToken].SourcePosition == StartPosition) NextToken++;
-					EndPosition = Tokens[NextToken].SourcePosition;
-					while (EndPosition > StartPosition && (Code[EndPosition] == L' ' || Code[EndPosition] < 32)) EndPosition--;
-				}
-			};
 			struct MacroInfo {
 				struct Macros {
 					string Identifier;
-					Array<Token> Tokens = Array<Token>(0x20);
+					SafePointer< Array<Token> > Tokens;
 				};
 				Array<Macros> Macroses = Array<Macros>(0x10);
+				Volumes::Dictionary<string, int> MacroIndex;
 
 				int GetMacroIndex(const string & name)
 				{
-					for (int i = 0; i < Macroses.Length(); i++) if (Macroses[i].Identifier == name) return i;
-					return -1;
+					auto index = MacroIndex[name];
+					return index ? *index : -1;
+				}
+				Macros & AddMacro(const string & name)
+				{
+					MacroIndex.Append(name, Macroses.Length());
+					Macroses.Append(Macros());
+					Macroses.LastElement().Identifier = name;
+					return Macroses.LastElement();
 				}
 			};
-			string LoadSource(const string & file_name)
+			string LoadSource(const string & file_name, string & digest)
 			{
 				try {
-					SafePointer<Stream> source = new FileStream(file_name, AccessRead, OpenExisting);
+					// The digest is taken from the very bytes that are parsed, so an edit during the compilation is not missed.
+					SafePointer<DataBlock> data;
+					{
+						FileStream file(file_name, AccessRead, OpenExisting);
+						data = file.ReadAll();
+					}
+					digest = FormatDigest(ComputeDigest(data->GetBuffer(), data->Length()));
+					SafePointer<Stream> source = new MemoryStream(data->GetBuffer(), data->Length());
 					TextReader reader(source);
 					DynamicString result;
 					while (!reader.EofReached()) {
@@ -134,75 +137,423 @@ namespace Engine
 					throw SourceLoadingException(file_name);
 				}
 			}
-			Array<Token> * ParseSource(const string & file_name, MacroInfo & macro, const string & inc_path, Spelling & spelling, string * store = 0)
+			struct TokenCacheHeader
+			{
+				char Signature[8];
+				uint32 Version;
+				uint32 TokenCount;
+				uint64 SourceDigest;
+				uint64 SpellingDigest;
+			};
+			struct TokenCacheRecord
+			{
+				uint8 Class;
+				uint8 ValueClass;
+				uint16 Reserved;
+				int32 SourcePosition;
+				int32 Length;
+			};
+			const char * TokenCacheSignature = "uimltkn";
+			const uint32 TokenCacheVersion = 1;
+			uint64 ComputeSpellingDigest(Spelling & spelling)
+			{
+				DynamicString desc;
+				desc << spelling.BooleanFalseLiteral << L"\n" << spelling.BooleanTrueLiteral << L"\n";
+				desc << spelling.CommentBlockOpeningWord << L"\n" << spelling.CommentBlockClosingWord << L"\n" << spelling.CommentEndOfLineWord << L"\n";
+				desc << spelling.InfinityLiteral << L"\n" << spelling.NonNumberLiteral << L"\n";
+				for (auto & k : spelling.Keywords) desc << k << L"\n";
+				for (auto & c : spelling.IsolatedChars) desc << c;
+				return ComputeDigest(desc.ToString());
+			}
+			string GetTokenCacheFile(const string & directory, const string & file_name)
+			{
+				return IO::ExpandPath(directory + L"/" + FormatDigest(ComputeDigest(file_name)) + L".etkc");
+			}
+			Array<Token> * LoadCachedTokens(const string & cache_file, const string & code, Spelling & spelling, uint64 source_digest, uint64 spelling_digest)
 			{
-				auto code = LoadSource(file_name);
-				if (store) *store = code;
-				SafePointer< Array<Token> > local_code = ParseText(code, spelling);
-				string inner_file;
-				string current_path = IO::Path::GetDirectory(file_name);
-				int outer_pos = -1;
 				try {
-					for (int i = 0; i < local_code->Length(); i++) {
+					FileStream stream(cache_file, AccessRead, OpenExisting);
+					TokenCacheHeader hdr;
+					stream.Read(&hdr, sizeof(hdr));
+					if (MemoryCompare(hdr.Signature, TokenCacheSignature, 8) || hdr.Version != TokenCacheVersion) return 0;
+					if (hdr.SourceDigest != source_digest || hdr.SpellingDigest != spelling_digest) return 0;
+					SafePointer< Array<Token> > tokens = new Array<Token>(0x1000);
+					Array<int> relex(0x100);
+					Array<uint8> content(0x100);
+					for (uint32 i = 0; i < hdr.TokenCount; i++) {
+						TokenCacheRecord rec;
+						stream.Read(&rec, sizeof(rec));
+						Token token;
+						token.Class = static_cast<TokenClass>(rec.Class);
+						token.ValueClass = static_cast<TokenConstantClass>(rec.ValueClass);
+						token.SourcePosition = rec.SourcePosition;
+						if (rec.Length > 0) {
+							content.SetLength(rec.Length);
+							stream.Read(content.GetBuffer(), rec.Length);
+							token.Content = string(content.GetBuffer(), rec.Length, Encoding::UTF8);
+						} else if (rec.Length < 0) relex << tokens->Length();
+						tokens->Append(token);
+					}
+					if (relex.Length()) {
+						DynamicString batch;
+						for (auto & index : relex) {
+							if (index + 1 >= tokens->Length()) return 0;
+							int from = tokens->ElementAt(index).SourcePosition;
+							int to = tokens->ElementAt(index + 1).SourcePosition;
+							if (from < 0 || to < from || to > code.Length()) return 0;
+							batch << code.Fragment(from, to - from) << L"\n";
+						}
+						SafePointer< Array<Token> > constants = ParseText(batch.ToString(), spelling);
+						if (constants->Length() != relex.Length() + 1) return 0;
+						for (int i = 0; i < relex.Length(); i++) {
+							auto & token = tokens->ElementAt(relex[i]);
+							int position = token.SourcePosition;
+							token = constants->ElementAt(i);
+							token.SourcePosition = position;
+						}
+					}
+					tokens->Retain();
+					return tokens;
+				} catch (...) { return 0; }
+			}
+			void SaveCachedTokens(const string & cache_file, Array<Token> & tokens, uint64 source_digest, uint64 spelling_digest)
+			{
+				try {
+					MemoryStream stream(0x10000);
+					TokenCacheHeader hdr;
+					MemoryCopy(hdr.Signature, TokenCacheSignature, 8);
+					hdr.Version = TokenCacheVersion;
+					hdr.TokenCount = tokens.Length();
+					hdr.SourceDigest = source_digest;
+					hdr.SpellingDigest = spelling_digest;
+					stream.Write(&hdr, sizeof(hdr));
+					for (auto & token : tokens) {
+						TokenCacheRecord rec;
+						rec.Class = uint8(token.Class);
+						rec.ValueClass = uint8(token.ValueClass);
+						rec.Reserved = 0;
+						rec.SourcePosition = token.SourcePosition;
+						if (token.Class == TokenClass::Constant && token.ValueClass != TokenConstantClass::String) {
+							rec.Length = -1;
+							stream.Write(&rec, sizeof(rec));
+						} else {
+							SafePointer< Array<uint8> > content = token.Content.EncodeSequence(Encoding::UTF8, false);
+							rec.Length = content->Length();
+							stream.Write(&rec, sizeof(rec));
+							if (rec.Length) stream.Write(content->GetBuffer(), rec.Length);
+						}
+					}
+					stream.Seek(0, Begin);
+					SafePointer<DataBlock> data = stream.ReadAll();
+					IO::CreateDirectoryTree(IO::Path::GetDirectory(cache_file));
+					FileStream file(cache_file, AccessReadWrite, CreateAlways);
+					file.Write(data->GetBuffer(), data->Length());
+				} catch (...) {}
+			}
+			class CompilationCache : public ICompilationCache
+			{
+				struct CachedSource
+				{
+					string Code;
+					string Digest;
+					SafePointer< Array<Token> > Tokens;
+				};
+				SafePointer<Semaphore> _sync;
+				Volumes::Dictionary<string, CachedSource> _sources;
+				Volumes::Dictionary<string, SafePointer<Codec::Image> > _images;
+				Volumes::Dictionary<string, string> _image_digests;
+				string _token_cache;
+
+				Array<Token> * _parse_source(const string & file_name, const string & code, Spelling & spelling)
+				{
+					if (!_token_cache.Length()) return ParseText(code, spelling);
+					auto cache_file = GetTokenCacheFile(_token_cache, file_name);
+					auto source_digest = ComputeDigest(code);
+					auto spelling_digest = ComputeSpellingDigest(spelling);
+					SafePointer< Array<Token> > tokens = LoadCachedTokens(cache_file, code, spelling, source_digest, spelling_digest);
+					if (!tokens) {
+						tokens = ParseText(code, spelling);
+						SaveCachedTokens(cache_file, *tokens, source_digest, spelling_digest);
+					}
+					tokens->Retain();
+					return tokens;
+				}
+			public:
+				CompilationCache(const string & token_cache) : _token_cache(token_cache) { _sync = CreateSemaphore(1); if (!_sync) throw Exception(); }
+				virtual ~CompilationCache(void) override {}
+				virtual void Clear(void) override
+				{
+					_sync->Wait();
+					_sources.Clear();
+					_images.Clear();
+					_image_digests.Clear();
+					_sync->Open();
+				}
+				Array<Token> * LoadTokens(const string & file_name, Spelling & spelling, string & code, string & digest)
+				{
+					SafePointer< Array<Token> > cached;
+					_sync->Wait();
+					auto source = _sources[file_name];
+					if (source) { code = source->Code; digest = source->Digest; cached = source->Tokens; }
+					_sync->Open();
+					if (!cached) {
+						CachedSource entry;
+						entry.Code = code = LoadSource(file_name, digest);
+						entry.Digest = digest;
+						entry.Tokens = _parse_source(file_name, code, spelling);
+						cached = entry.Tokens;
+						_sync->Wait();
+						if (!_sources[file_name]) _sources.Append(file_name, entry);
+						_sync->Open();
+					}
+					cached->Retain();
+					return cached;
+				}
+				Codec::Image * GetImage(const string & key)
+				{
+					Codec::Image * result = 0;
+					_sync->Wait();
+					auto image = _images[key];
+					if (image) { result = *image; result->Retain(); }
+					_sync->Open();
+					return result;
+				}
+				void SetImage(const string & key, Codec::Image * image)
+				{
+					SafePointer<Codec::Image> entry;
+					entry.SetRetain(image);
+					_sync->Wait();
+					if (!_images[key]) _images.Append(key, entry);
+					_sync->Open();
+				}
+				string RegisterImageDigest(const string & path, const string & digest)
+				{
+					// Images of one file are decoded for every scale and effect set, if the file changed in between
+					// the digest is dropped and no dependency manifest can be written for it.
+					string result;
+					_sync->Wait();
+					auto known = _image_digests[path];
+					if (!known) _image_digests.Append(path, digest);
+					else if (*known != digest) *known = L"";
+					result = known ? *known : digest;
+					_sync->Open();
+					return result;
+				}
+				string GetImageDigest(const string & path)
+				{
+					string result;
+					_sync->Wait();
+					auto known = _image_digests[path];
+					if (known) result = *known;
+					_sync->Open();
+					return result;
+				}
+			};
+			ICompilationCache * CreateCompilationCache(const string & token_cache) { return new CompilationCache(token_cache); }
+			Array<Token> * LoadTokens(const string & file_name, Spelling & spelling, CompilationCache * cache, string & code, string & digest)
+			{
+				if (cache) return cache->LoadTokens(file_name, spelling, code, digest);
+				code = LoadSource(file_name, digest);
+				return ParseText(code, spelling);
+			}
+			void AddDependency(Array<SourceDependency> * dependencies, const string & file_name, const string & digest)
+			{
+				if (!dependencies) return;
+				for (auto & d : *dependencies) if (d.Path == file_name) {
+					if (d.Digest != digest) d.Digest = L"";
+					return;
+				}
+				SourceDependency dependency;
+				dependency.Path = file_name;
+				dependency.Digest = digest;
+				dependencies->Append(dependency);
+			}
+			class TokenStream
+			{
+				struct Segment
+				{
+					SafePointer< Array<Token> > Tokens;
+					int Position;
+				};
+				struct SourceFrame
+				{
+					string Directory;
+					Array<Segment> Segments = Array<Segment>(0x10);
+				};
+				// Tokens are stored in fixed size chunks so that references returned to the parser survive further expansion.
+				enum { ChunkSize = 0x400 };
+
+				Array< SafePointer< Array<Token> > > _chunks;
+				int _length;
+				bool _finished;
+				Array<SourceFrame> _frames;
+				MacroInfo & _macro;
+				string _inc_path;
+				Spelling & _spelling;
+				CompilationCache * _cache;
+				Array<SourceDependency> * _dependencies;
+				string _include_file;
+				int _include_position;
+
+				void _push_file(const string & file_name, string * store = 0)
+				{
+					string code, digest;
+					SourceFrame frame;
+					frame.Directory = IO::Path::GetDirectory(file_name);
+					frame.Segments << Segment();
+					frame.Segments.LastElement().Tokens = LoadTokens(file_name, _spelling, _cache, code, digest);
+					AddDependency(_dependencies, file_name, digest);
+					frame.Segments.LastElement().Position = 0;
+					if (store) *store = code;
+					_frames << frame;
+				}
+				void _push_tokens(SourceFrame & frame, Array<Token> * tokens)
+				{
+					if (!tokens->Length()) return;
+					frame.Segments << Segment();
+					frame.Segments.LastElement().Tokens.SetRetain(tokens);
+					frame.Segments.LastElement().Position = 0;
+				}
+				Token * _peek(SourceFrame & frame, int shift)
+				{
+					for (int i = frame.Segments.Length() - 1; i >= 0; i--) {
+						auto & segment = frame.Segments[i];
+						int available = segment.Tokens->Length() - segment.Position;
+						if (shift < available) return &segment.Tokens->ElementAt(segment.Position + shift);
+						shift -= available;
+					}
+					return 0;
+				}
+				void _consume(SourceFrame & frame, int count)
+				{
+					while (count) {
+						auto & segment = frame.Segments.LastElement();
+						int available = segment.Tokens->Length() - segment.Position;
+						if (count < available) {
+							segment.Position += count;
+							count = 0;
+						} else {
+							count -= available;
+							frame.Segments.RemoveLast();
+						}
+					}
+				}
+				void _emit(const Token & token)
+				{
+					if (_length == _chunks.Length() * ChunkSize) {
+						SafePointer< Array<Token> > chunk = new Array<Token>(ChunkSize);
+						_chunks << chunk;
+					}
+					_chunks.LastElement()->Append(token);
+					if (_frames.Length() > 1) _chunks.LastElement()->LastElement().SourcePosition = _include_position;
+					_length++;
+				}
+				void _produce(void)
+				{
+					while (true) {
+						auto & frame = _frames.LastElement();
+						auto & token = *_peek(frame, 0);
 						int mi;
-						if (local_code->ElementAt(i).Class == TokenClass::CharCombo && local_code->ElementAt(i).Content == L"#") {
-							if ((local_code->ElementAt(i + 1).Class == TokenClass::Constant && local_code->ElementAt(i + 1).ValueClass == TokenConstantClass::String) ||
-								local_code->ElementAt(i + 1).Class == TokenClass::Identifier) {
-								outer_pos = local_code->ElementAt(i + 1).SourcePosition;
-								string resource = (local_code->ElementAt(i + 1).Class == TokenClass::Identifier) ? (local_code->ElementAt(i + 1).Content + L"/main.uiml") : local_code->ElementAt(i + 1).Content;
-								inner_file = IO::ExpandPath(current_path + L"/" + resource);
-								if (!IO::FileExists(inner_file) && inc_path.Length()) {
-									string alt = IO::ExpandPath(inc_path + L"/" + resource);
+						if (token.Class == TokenClass::CharCombo && token.Content == L"#") {
+							auto next = _peek(frame, 1);
+							if (next && ((next->Class == TokenClass::Constant && next->ValueClass == TokenConstantClass::String) || next->Class == TokenClass::Identifier)) {
+								string resource = (next->Class == TokenClass::Identifier) ? (next->Content + L"/main.uiml") : next->Content;
+								string inner_file = IO::ExpandPath(frame.Directory + L"/" + resource);
+								if (!IO::FileExists(inner_file) && _inc_path.Length()) {
+									string alt = IO::ExpandPath(_inc_path + L"/" + resource);
 									if (IO::FileExists(alt)) inner_file = alt;
 								}
-								SafePointer< Array<Token> > inner_code = ParseSource(inner_file, macro, inc_path, spelling);
-								for (int j = 0; j < inner_code->Length(); j++) inner_code->ElementAt(j).SourcePosition = outer_pos;
-								inner_code->RemoveLast();
-								SafePointer< Array<Token> > new_local = new Array<Token>(0x1000);
-								new_local->Append(local_code->GetBuffer(), i);
-								new_local->Append(*inner_code);
-								new_local->Append(local_code->GetBuffer() + i + 2, local_code->Length() - i - 2);
-								local_code.SetRetain(new_local);
-								i += inner_code->Length() - 1;
-							} else {
-								throw InnerSourceWrongIncludeException(local_code->ElementAt(i + 1).SourcePosition);
-							}
-						} else if (local_code->ElementAt(i).Class == TokenClass::CharCombo && local_code->ElementAt(i).Content == L"&" && local_code->ElementAt(i + 1).Class == TokenClass::Constant && local_code->ElementAt(i + 1).ValueClass == TokenConstantClass::String) {
-							local_code->ElementAt(i + 1).Content = IO::ExpandPath(current_path + L"/" + local_code->ElementAt(i + 1).Content);
-						} else if (local_code->ElementAt(i).Class == TokenClass::CharCombo && local_code->ElementAt(i).Content == L"$" && local_code->ElementAt(i + 1).Class == TokenClass::Identifier) {
-							int mbegin = i;
-							int mend = i + 1;
-							auto & name = local_code->ElementAt(i + 1).Content;
-							while (mend < local_code->Length() && (local_code->ElementAt(mend).Class != TokenClass::CharCombo || local_code->ElementAt(mend).Content != L"$")) mend++;
-							if (mend < local_code->Length() && macro.GetMacroIndex(name) == -1) {
-								macro.Macroses.Append(MacroInfo::Macros());
-								macro.Macroses.LastElement().Identifier = name;
-								macro.Macroses.LastElement().Tokens.Append(local_code->GetBuffer() + mbegin + 2, mend - mbegin - 2);
-								while (mend >= mbegin) {
-									local_code->Remove(mend);
-									mend--;
+								if (_frames.Length() == 1) {
+									_include_file = inner_file;
+									_include_position = next->SourcePosition;
 								}
-								i--;
+								_consume(frame, 2);
+								_push_file(inner_file);
+							} else throw InnerSourceWrongIncludeException(next ? next->SourcePosition : token.SourcePosition);
+						} else if (token.Class == TokenClass::CharCombo && token.Content == L"&") {
+							auto next = _peek(frame, 1);
+							if (next && next->Class == TokenClass::Constant && next->ValueClass == TokenConstantClass::String) {
+								Token path = *next;
+								path.Content = IO::ExpandPath(frame.Directory + L"/" + next->Content);
+								_emit(token);
+								_emit(path);
+								_consume(frame, 2);
+								return;
 							}
-						} else if (local_code->ElementAt(i).Class == TokenClass::Identifier && (mi = macro.GetMacroIndex(local_code->ElementAt(i).Content)) != -1) {
-							SafePointer< Array<Token> > new_local = new Array<Token>(0x1000);
-							new_local->Append(local_code->GetBuffer(), i);
-							new_local->Append(macro.Macroses[mi].Tokens);
-							new_local->Append(local_code->GetBuffer() + i + 1, local_code->Length() - i - 1);
-							local_code.SetRetain(new_local);
-							i--;
+							_emit(token);
+							_consume(frame, 1);
+							return;
+						} else if (token.Class == TokenClass::CharCombo && token.Content == L"$" && _peek(frame, 1) && _peek(frame, 1)->Class == TokenClass::Identifier) {
+							auto & name = _peek(frame, 1)->Content;
+							int mend = 1;
+							Token * closing;
+							while ((closing = _peek(frame, mend)) && (closing->Class != TokenClass::CharCombo || closing->Content != L"$")) mend++;
+							if (closing && _macro.GetMacroIndex(name) == -1) {
+								auto & definition = _macro.AddMacro(name);
+								definition.Tokens = new Array<Token>(0x20);
+								for (int i = 2; i < mend; i++) definition.Tokens->Append(*_peek(frame, i));
+								_consume(frame, mend + 1);
+							} else {
+								_emit(token);
+								_consume(frame, 1);
+								return;
+							}
+						} else if (token.Class == TokenClass::Identifier && (mi = _macro.GetMacroIndex(token.Content)) != -1) {
+							_consume(frame, 1);
+							_push_tokens(frame, _macro.Macroses[mi].Tokens);
+						} else if (token.Class == TokenClass::EndOfStream && _frames.Length() > 1) {
+							_frames.RemoveLast();
+						} else {
+							if (token.Class == TokenClass::EndOfStream) _finished = true;
+							_emit(token);
+							_consume(frame, 1);
+							return;
 						}
 					}
-					local_code->Retain();
-					return local_code;
-				} catch (SourceLoadingException) {
-					throw;
-				} catch (InnerSourceWrongIncludeException & e) {
-					throw ParserSpellingException(e.OuterPosition, L"Invalid include directive.");
-				} catch (...) {
-					throw InnerSourceErrorException(inner_file, outer_pos);
 				}
-			}
+			public:
+				TokenStream(const string & file_name, MacroInfo & macro, const string & inc_path, Spelling & spelling, CompilationCache * cache, Array<SourceDependency> * dependencies, string * store) :
+					_chunks(0x100), _length(0), _finished(false), _frames(0x10), _macro(macro), _inc_path(inc_path), _spelling(spelling), _cache(cache), _dependencies(dependencies), _include_position(-1)
+				{ _push_file(file_name, store); }
+				bool Exists(int index)
+				{
+					if (index < 0) return false;
+					while (index >= _length && !_finished) {
+						try {
+							_produce();
+						} catch (SourceLoadingException) {
+							throw;
+						} catch (InnerSourceWrongIncludeException & e) {
+							if (_frames.Length() > 1) throw InnerSourceErrorException(_include_file, _include_position);
+							throw ParserSpellingException(e.OuterPosition, L"Invalid include directive.");
+						} catch (...) {
+							throw InnerSourceErrorException(_include_file, _include_position);
+						}
+					}
+					return index < _length;
+				}
+				Token & operator [] (int index)
+				{
+					if (!Exists(index)) throw InvalidArgumentException();
+					return _chunks[index / ChunkSize]->ElementAt(index % ChunkSize);
+				}
+			};
+			class SyntaxException : public Exception
+			{
+			public:
+				int StartPosition;
+				int EndPosition;
+				ErrorClass LocalError;
+				SyntaxException(const string & Code, TokenStream & Tokens, int Position, ErrorClass cls)
+				{
+					StartPosition = Tokens[Position].SourcePosition;
+					LocalError = cls;
+					int NextToken = Position;
+					while (Tokens.Exists(NextToken) && Tokens[NextToken].SourcePosition == StartPosition) NextToken++;
+					EndPosition = Tokens[NextToken].SourcePosition;
+					while (EndPosition > StartPosition && (Code[EndPosition] == L' ' || Code[EndPosition] < 32)) EndPosition--;
+				}
+			};
 			bool CheckPlatformName(const string & name)
 			{
 				if (name == L"Windows") return true;
@@ -221,36 +572,59 @@ namespace Engine
 					Array<Format::InterfaceDialog> Styles;
 					SafeArray<Format::InterfaceDialog> Dialogs;
 
+					Volumes::Dictionary<int, int> ColorIndex;
+					Volumes::Dictionary<string, int> TextureIndex;
+					Volumes::Dictionary<string, int> FontIndex;
+					Volumes::Dictionary<string, int> ApplicationIndex;
+					Volumes::Dictionary<string, int> StyleIndex;
+					Volumes::Dictionary<string, int> DialogIndex;
+
 					PlatformContents(void) : Colors(0x10), Textures(0x10), Fonts(0x10), Applications(0x40), Styles(0x40), Dialogs(0x40) {}
-					int GetColorIndex(int ID)
+					static string StyleKey(const string & name, const string & cls) { return cls + L":" + name; }
+					int GetColorIndex(int ID) { auto index = ColorIndex[ID]; return index ? *index : -1; }
+					int GetTextureIndex(const string & name) { auto index = TextureIndex[name]; return index ? *index : -1; }
+					int GetFontIndex(const string & name) { auto index = FontIndex[name]; return index ? *index : -1; }
+					int GetApplicationIndex(const string & name) { auto index = ApplicationIndex[name]; return index ? *index : -1; }
+					int GetStyleIndex(const string & name, const string & cls) { auto index = StyleIndex[StyleKey(name, cls)]; return index ? *index : -1; }
+					int GetDialogIndex(const string & name) { auto index = DialogIndex[name]; return index ? *index : -1; }
+					void AddColor(const Format::InterfaceColor & color)
 					{
-						for (int i = 0; i < Colors.Length(); i++) if (Colors[i].ID == ID) return i;
-						return -1;
+						ColorIndex.Append(color.ID, Colors.Length());
+						Colors << color;
 					}
-					int GetTextureIndex(const string & name)
+					void AddTexture(const Format::InterfaceTexture & texture)
 					{
-						for (int i = 0; i < Textures.Length(); i++) if (Textures[i].Name == name) return i;
-						return -1;
+						TextureIndex.Append(texture.Name, Textures.Length());
+						Textures << texture;
 					}
-					int GetFontIndex(const string & name)
+					Format::InterfaceFont & AddFont(const string & name)
 					{
-						for (int i = 0; i < Fonts.Length(); i++) if (Fonts[i].Name == name) return i;
-						return -1;
+						FontIndex.Append(name, Fonts.Length());
+						Fonts.Append(Format::InterfaceFont());
+						Fonts.LastElement().Name = name;
+						return Fonts.LastElement();
 					}
-					int GetApplicationIndex(const string & name)
+					Format::InterfaceApplication & AddApplication(const string & name)
 					{
-						for (int i = 0; i < Applications.Length(); i++) if (Applications[i].Name == name) return i;
-						return -1;
+						ApplicationIndex.Append(name, Applications.Length());
+						Applications.Append(Format::InterfaceApplication());
+						Applications.LastElement().Name = name;
+						return Applications.LastElement();
 					}
-					int GetStyleIndex(const string & name, const string & cls)
+					Format::InterfaceDialog & AddStyle(const string & name, const string & cls)
 					{
-						for (int i = 0; i < Styles.Length(); i++) if (Styles[i].Name == name && Styles[i].Root.Class == cls) return i;
-						return -1;
+						StyleIndex.Append(StyleKey(name, cls), Styles.Length());
+						Styles.Append(Format::InterfaceDialog());
+						Styles.LastElement().Name = name;
+						Styles.LastElement().Root.Class = cls;
+						return Styles.LastElement();
 					}
-					int GetDialogIndex(const string & name)
+					Format::InterfaceDialog & AddDialog(const string & name)
 					{
-						for (int i = 0; i < Dialogs.Length(); i++) if (Dialogs[i].Name == name) return i;
-						return -1;
+						DialogIndex.Append(name, Dialogs.Length());
+						Dialogs.Append(Format::InterfaceDialog());
+						Dialogs.LastElement().Name = name;
+						return Dialogs.LastElement();
 					}
 				};
 				struct LocaleString {
@@ -329,14 +703,24 @@ namespace Engine
 				Array<ColorAlias> Colors;
 				Array<DefaultStyle> DefaultStyles;
 				Array<PlatformContents> Contents;
+				Volumes::Dictionary<string, int> ConstantIndex;
+				Volumes::Dictionary<string, int> StringIndex;
+				Volumes::Dictionary<string, int> ColorIndex;
+				Volumes::Dictionary<string, int> DefaultStyleIndex;
+				Volumes::Dictionary<string, int> ContentsIndex;
+				Volumes::Dictionary<uint64, int> TextureDigests;
+				Volumes::Dictionary<int, SafePointer<Codec::Image> > TextureImages;
 
 				const string & Code;
 				Format::InterfaceTemplateImage & Output;
-				Array<Token> & Tokens;
+				TokenStream & Tokens;
 				int Position;
+				IWarningReporter * Reporter;
+				CompilationCache * Cache;
+				Array<SourceDependency> * Dependencies;
 
-				DynamicInfo(const string & code, Array<Token> & src, Format::InterfaceTemplateImage & out) : LastSet(0x10), GlobalLocaleSet(0x10), TextureID(1), UnnamedObject(0), ClassData(0x100),
-					Constants(0x20), Strings(0x100), Colors(0x40), DefaultStyles(0x20), Contents(0x10), Code(code), Output(out), Tokens(src), Position(0)
+				DynamicInfo(const string & code, TokenStream & src, Format::InterfaceTemplateImage & out, IWarningReporter * reporter, CompilationCache * cache, Array<SourceDependency> * dependencies) : LastSet(0x10), GlobalLocaleSet(0x10), TextureID(1), UnnamedObject(0), ClassData(0x100),
+					Constants(0x20), Strings(0x100), Colors(0x40), DefaultStyles(0x20), Contents(0x10), Code(code), Output(out), Tokens(src), Position(0), Reporter(reporter), Cache(cache), Dependencies(dependencies)
 				{
 					GlobalLocaleSet << L"_"; LastSet << L"_";
 					if (subordering) {
@@ -359,47 +743,70 @@ namespace Engine
 				void MoveNext(int shift = 1) { Position += shift; }
 				int GetStringID(const string & name)
 				{
-					for (int i = 0; i < Strings.Length(); i++) if (Strings[i].HumanIdentifier == name) return Strings[i].MachineIdentifier;
-					return -1;
+					auto index = StringIndex[name];
+					return index ? Strings[*index].MachineIdentifier : -1;
 				}
 				int GetColorID(const string & name)
 				{
-					for (int i = 0; i < Colors.Length(); i++) if (Colors[i].HumanIdentifier == name) return Colors[i].MachineIdentifier;
-					return -1;
+					auto index = ColorIndex[name];
+					return index ? Colors[*index].MachineIdentifier : -1;
 				}
 				int GetConstantIndex(const string & name)
 				{
-					for (int i = 0; i < Constants.Length(); i++) if (Constants[i].Name == name) return i;
-					return -1;
+					auto index = ConstantIndex[name];
+					return index ? *index : -1;
+				}
+				void AddConstant(const Constant & value)
+				{
+					ConstantIndex.Append(value.Name, Constants.Length());
+					Constants << value;
+				}
+				void AddString(const LocaleString & value)
+				{
+					StringIndex.Append(value.HumanIdentifier, Strings.Length());
+					Strings << value;
+				}
+				void AddColorAlias(const ColorAlias & value)
+				{
+					ColorIndex.Append(value.HumanIdentifier, Colors.Length());
+					Colors << value;
 				}
 				PlatformContents & GetContentsFor(const string & platform)
 				{
-					for (int i = 0; i < Contents.Length(); i++) if (Contents[i].PlatformName == platform) return Contents[i];
+					auto index = ContentsIndex[platform];
+					if (index) return Contents[*index];
+					ContentsIndex.Append(platform, Contents.Length());
 					Contents << PlatformContents();
 					Contents.LastElement().PlatformName = platform;
 					return Contents.LastElement();
 				}
 				Format::InterfaceApplication * FindApplication(const string & name)
 				{
-					for (int p = 0; p < Contents.Length(); p++) for (int a = 0; a < Contents[p].Applications.Length(); a++) if (Contents[p].Applications[a].Name == name) return &Contents[p].Applications[a];
+					for (int p = 0; p < Contents.Length(); p++) {
+						int index = Contents[p].GetApplicationIndex(name);
+						if (index != -1) return &Contents[p].Applications[index];
+					}
 					return 0;
 				}
 				string GetDefaultStyle(const string & class_for)
 				{
-					for (int i = 0; i < DefaultStyles.Length(); i++) if (DefaultStyles[i].Class == class_for) return DefaultStyles[i].Style;
-					return L"";
+					auto index = DefaultStyleIndex[class_for];
+					return index ? DefaultStyles[*index].Style : string(L"");
 				}
 				void SetDefaultStyle(const string & class_for, const string & style)
 				{
-					for (int i = 0; i < DefaultStyles.Length(); i++) if (DefaultStyles[i].Class == class_for) {
-						DefaultStyles[i].Style = style;
+					auto index = DefaultStyleIndex[class_for];
+					if (index) {
+						DefaultStyles[*index].Style = style;
 						return;
 					}
+					DefaultStyleIndex.Append(class_for, DefaultStyles.Length());
 					DefaultStyle stl;
 					stl.Class = class_for; stl.Style = style;
 					DefaultStyles << stl;
 				}
 				int GetUnnamed(void) { UnnamedObject++; return UnnamedObject; }
+				int RegisterTexture(Codec::Image * image);
 			};
 #define DED(info) info.Code, info.Tokens, info.Position
 			DynamicInfo::Constant EXPRESSION(DynamicInfo & info);
@@ -713,21 +1120,103 @@ namespace Engine
 				info.MoveNext();
 				return result;
 			}
-			Codec::Image * IMAGE_IMPORT(DynamicInfo & info)
+			bool ReadEffectArgument(TokenStream & tokens, int position, uint8 & value)
 			{
-				double scale = 0.0;
-				if (info.GetToken().Class == TokenClass::Constant && info.GetToken().ValueClass == TokenConstantClass::Numeric) {
-					scale = info.GetToken().AsDouble();
-					info.MoveNext();
+				if (!tokens.Exists(position) || tokens[position].Class != TokenClass::Constant || tokens[position].ValueClass != TokenConstantClass::Numeric) return false;
+				if (tokens[position].NumericClass() == NumericTokenClass::Integer) {
+					auto val = tokens[position].AsInteger();
+					if (val > 255) value = 255; else value = uint8(val);
+				} else {
+					auto val = min(max(tokens[position].AsDouble(), 0.0), 1.0);
+					value = uint8(255.0 * val);
+				}
+				return true;
+			}
+			int ReadImageEffect(TokenStream & tokens, int position, string & effect)
+			{
+				if (!tokens.Exists(position) || tokens[position].Class != TokenClass::Identifier) return 0;
+				auto & name = tokens[position].Content;
+				if (name == L"Grayscale" || name == L"BlindGrayscale" || name == L"Downscale") { effect = name; return 1; }
+				int min_args, max_args;
+				if (name == L"Opacity") { min_args = max_args = 1; }
+				else if (name == L"Tint") { min_args = 3; max_args = 4; }
+				else return 0;
+				uint8 args[4] = { 255, 255, 255, 255 };
+				int index = position + 1, count = 0;
+				if (!tokens.Exists(index) || tokens[index].Class != TokenClass::CharCombo || tokens[index].Content != L'(') return 0;
+				index++;
+				while (true) {
+					if (count == max_args || !ReadEffectArgument(tokens, index, args[count])) return 0;
+					count++;
+					index++;
+					if (!tokens.Exists(index) || tokens[index].Class != TokenClass::CharCombo) return 0;
+					if (tokens[index].Content == L')') break;
+					if (tokens[index].Content != L',') return 0;
+					index++;
+				}
+				if (count < min_args) return 0;
+				DynamicString result;
+				result << name << L"(";
+				for (int i = 0; i < max_args; i++) { if (i) result << L","; result << string(uint32(args[i])); }
+				result << L")";
+				effect = result.ToString();
+				return index - position + 1;
+			}
+			void ParseEffectArguments(const string & effect, uint8 * args)
+			{
+				auto list = effect.Fragment(effect.FindFirst(L'(') + 1, -1).Replace(L")", L"").Split(L',');
+				for (int i = 0; i < list.Length() && i < 4; i++) args[i] = uint8(list[i].ToUInt32());
+			}
+			void ApplyImageEffect(Codec::Image * image, const string & effect)
+			{
+				uint8 args[4] = { 255, 255, 255, 255 };
+				if (effect.FindFirst(L'(') >= 0) ParseEffectArguments(effect, args);
+				for (int f = 0; f < image->Frames.Length(); f++) {
+					auto frame = image->Frames.ElementAt(f);
+					if (effect == L"Downscale") {
+						SafePointer<Codec::Frame> scaled = CreateDownscaledFrame(frame);
+						if (scaled->DpiUsage) scaled->DpiUsage /= 2.0;
+						image->Frames.SetElement(scaled, f);
+						continue;
+					}
+					PixelBuffer buffer;
+					if (!GetFramePixels(frame, buffer)) continue;
+					bool premultiplied = frame->GetAlphaMode() == Codec::AlphaMode::Premultiplied;
+					if (effect == L"Grayscale") PixelGrayscale(buffer);
+					else if (effect == L"BlindGrayscale") PixelBlindGrayscale(buffer);
+					else if (effect.FindFirst(L"Opacity(") == 0) PixelOpacity(buffer, args[0], premultiplied);
+					else if (effect.FindFirst(L"Tint(") == 0) PixelTint(buffer, args[0], args[1], args[2], args[3]);
+				}
+			}
+			string GetImageKey(const string & path, double scale, const Array<string> & effects)
+			{
+				DynamicString key;
+				key << path << L"|" << string(scale);
+				for (auto & e : effects) key << L"|" << e;
+				return key.ToString();
+			}
+			Codec::Image * LoadImage(const string & path, double scale, const Array<string> & effects, CompilationCache * cache, string * digest = 0)
+			{
+				auto key = GetImageKey(path, scale, effects);
+				if (cache) {
+					auto cached = cache->GetImage(key);
+					if (cached) {
+						if (digest) *digest = cache->GetImageDigest(path);
+						return cached;
+					}
 				}
-				if (info.GetToken().Class != TokenClass::CharCombo || info.GetToken().Content != L'&') throw SyntaxException(DED(info), ErrorClass::UnexpectedLexem);
-				info.MoveNext();
-				if (info.GetToken().Class != TokenClass::Constant || info.GetToken().ValueClass != TokenConstantClass::String) throw SyntaxException(DED(info), ErrorClass::UnexpectedLexem);
-				string path = info.GetToken().Content;
 				SafePointer<Codec::Image> result;
 				{
 					try {
-						SafePointer<Stream> stream = new FileStream(path, AccessRead, OpenExisting);
+						SafePointer<DataBlock> data;
+						{
+							FileStream file(path, AccessRead, OpenExisting);
+							data = file.ReadAll();
+						}
+						auto data_digest = FormatDigest(ComputeDigest(data->GetBuffer(), data->Length()));
+						if (cache) data_digest = cache->RegisterImageDigest(path, data_digest);
+						if (digest) *digest = data_digest;
+						SafePointer<Stream> stream = new MemoryStream(data->GetBuffer(), data->Length());
 						result = Codec::DecodeImage(stream);
 						if (!result) throw Exception();
 					}
@@ -738,32 +1227,114 @@ namespace Engine
 					SafePointer<Codec::Frame> conv = result->Frames.ElementAt(i)->ConvertFormat(Codec::PixelFormat::R8G8B8A8, Codec::AlphaMode::Normal, Codec::ScanOrigin::BottomUp);
 					result->Frames.SetElement(conv, i);
 				}
+				for (auto & e : effects) ApplyImageEffect(result, e);
+				if (cache) cache->SetImage(key, result);
+				result->Retain();
+				return result;
+			}
+			class ImageDecodeTask : public IDispatchTask
+			{
+			public:
+				string Path;
+				double Scale;
+				Array<string> Effects;
+				CompilationCache * Cache;
+
+				ImageDecodeTask(const string & path, double scale, CompilationCache * cache) : Path(path), Scale(scale), Effects(0x10), Cache(cache) {}
+				virtual void DoTask(IDispatchQueue * queue) override
+				{
+					try { SafePointer<Codec::Image> image = LoadImage(Path, Scale, Effects, Cache); } catch (...) {}
+				}
+			};
+			void PrefetchImages(TokenStream & tokens, CompilationCache * cache)
+			{
+				ObjectArray<ImageDecodeTask> tasks(0x40);
+				Volumes::Dictionary<string, int> keys;
+				for (int i = 0; tokens.Exists(i + 1); i++) {
+					if (tokens[i].Class != TokenClass::CharCombo || tokens[i].Content != L"&") continue;
+					if (tokens[i + 1].Class != TokenClass::Constant || tokens[i + 1].ValueClass != TokenConstantClass::String) continue;
+					double scale = 0.0;
+					if (i && tokens[i - 1].Class == TokenClass::Constant && tokens[i - 1].ValueClass == TokenConstantClass::Numeric) scale = tokens[i - 1].AsDouble();
+					SafePointer<ImageDecodeTask> task = new ImageDecodeTask(tokens[i + 1].Content, scale, cache);
+					string effect;
+					for (int j = i + 2, length; (length = ReadImageEffect(tokens, j, effect)); j += length) task->Effects << effect;
+					auto key = GetImageKey(task->Path, task->Scale, task->Effects);
+					if (keys[key]) continue;
+					keys.Append(key, tasks.Length());
+					tasks.Append(task);
+				}
+				if (tasks.Length() < 2) return;
+				SafePointer<ThreadPool> pool;
+				try { pool = new ThreadPool; } catch (...) {}
+				if (pool) {
+					for (auto & t : tasks) pool->SubmitTask(&t);
+					pool->Wait();
+				} else for (auto & t : tasks) t.DoTask(0);
+			}
+			uint64 ComputeImageDigest(Codec::Image * image)
+			{
+				uint64 digest = DigestSeed;
+				for (auto & frame : image->Frames) {
+					int header[3] = { frame.GetWidth(), frame.GetHeight(), frame.GetScanLineLength() };
+					digest = ComputeDigest(header, sizeof(header), digest);
+					digest = ComputeDigest(&frame.DpiUsage, sizeof(frame.DpiUsage), digest);
+					digest = ComputeDigest(frame.GetData(), frame.GetScanLineLength() * frame.GetHeight(), digest);
+				}
+				return digest;
+			}
+			bool CompareImages(Codec::Image * a, Codec::Image * b)
+			{
+				if (a->Frames.Length() != b->Frames.Length()) return false;
+				for (int i = 0; i < a->Frames.Length(); i++) {
+					auto fa = a->Frames.ElementAt(i);
+					auto fb = b->Frames.ElementAt(i);
+					if (fa == fb) continue;
+					if (fa->GetWidth() != fb->GetWidth() || fa->GetHeight() != fb->GetHeight() || fa->DpiUsage != fb->DpiUsage) return false;
+					if (fa->GetPixelFormat() != fb->GetPixelFormat() || fa->GetScanLineLength() != fb->GetScanLineLength()) return false;
+					if (MemoryCompare(fa->GetData(), fb->GetData(), fa->GetScanLineLength() * fa->GetHeight())) return false;
+				}
+				return true;
+			}
+			int DynamicInfo::RegisterTexture(Codec::Image * image)
+			{
+				auto digest = ComputeImageDigest(image);
+				auto existing = TextureDigests[digest];
+				if (existing) {
+					auto stored = TextureImages[*existing];
+					if (stored && CompareImages(*stored, image)) return *existing;
+				} else TextureDigests.Append(digest, TextureID);
+				SafePointer<Codec::Image> entry;
+				entry.SetRetain(image);
+				TextureImages.Append(TextureID, entry);
+				Output.Textures.Append(TextureID, entry);
+				TextureID++;
+				return TextureID - 1;
+			}
+			Codec::Image * IMAGE_IMPORT(DynamicInfo & info)
+			{
+				double scale = 0.0;
+				if (info.GetToken().Class == TokenClass::Constant && info.GetToken().ValueClass == TokenConstantClass::Numeric) {
+					scale = info.GetToken().AsDouble();
+					info.MoveNext();
+				}
+				if (info.GetToken().Class != TokenClass::CharCombo || info.GetToken().Content != L'&') throw SyntaxException(DED(info), ErrorClass::UnexpectedLexem);
+				info.MoveNext();
+				if (info.GetToken().Class != TokenClass::Constant || info.GetToken().ValueClass != TokenConstantClass::String) throw SyntaxException(DED(info), ErrorClass::UnexpectedLexem);
+				string path = info.GetToken().Content;
 				info.MoveNext();
+				Array<string> effects(0x10);
+				int invalid_effect = -1;
 				while (info.GetToken().Class == TokenClass::Identifier) {
-					auto & effect = info.GetToken().Content;
-					if (effect == L"Grayscale") {
-						for (int f = 0; f < result->Frames.Length(); f++) {
-							auto & frame = result->Frames[f];
-							for (int y = 0; y < frame.GetHeight(); y++) for (int x = 0; x < frame.GetWidth(); x++) {
-								Color clr = frame.GetPixel(x, y);
-								uint8 v = uint8((uint32(clr.r) + uint32(clr.g) + uint32(clr.b)) / 3);
-								clr.r = clr.g = clr.b = v;
-								frame.SetPixel(x, y, clr);
-							}
-						}
-					} else if (effect == L"BlindGrayscale") {
-						for (int f = 0; f < result->Frames.Length(); f++) {
-							auto & frame = result->Frames[f];
-							for (int y = 0; y < frame.GetHeight(); y++) for (int x = 0; x < frame.GetWidth(); x++) {
-								Color clr = frame.GetPixel(x, y);
-								uint8 v = 64 + uint8((uint32(clr.r) + uint32(clr.g) + uint32(clr.b)) / 6);
-								clr.r = clr.g = clr.b = v;
-								frame.SetPixel(x, y, clr);
-							}
-						}
-					} else throw SyntaxException(DED(info), ErrorClass::InvalidEffect);
-					info.MoveNext();
+					string effect;
+					int length = ReadImageEffect(info.Tokens, info.Position, effect);
+					if (!length) { invalid_effect = info.Position; break; }
+					effects << effect;
+					info.MoveNext(length);
 				}
+				string digest;
+				SafePointer<Codec::Image> result = LoadImage(path, scale, effects, info.Cache, &digest);
+				AddDependency(info.Dependencies, path, digest);
+				if (invalid_effect >= 0) throw SyntaxException(info.Code, info.Tokens, invalid_effect, ErrorClass::InvalidEffect);
 				result->Retain();
 				return result;
 			}
@@ -771,7 +1342,9 @@ namespace Engine
 			{
 				if (info.GetToken().Class != TokenClass::CharCombo || info.GetToken().Content != L'{') throw SyntaxException(DED(info), ErrorClass::UnexpectedLexem);
 				info.MoveNext();
-				SafePointer<Codec::Image> result = IMAGE_IMPORT(info);
+				SafePointer<Codec::Image> result = new Codec::Image;
+				SafePointer<Codec::Image> first = IMAGE_IMPORT(info);
+				result->Frames << first->Frames;
 				while (info.GetToken().Class == TokenClass::CharCombo && info.GetToken().Content == L',') {
 					info.MoveNext();
 					SafePointer<Codec::Image> next = IMAGE_IMPORT(info);
@@ -1394,9 +1967,7 @@ namespace Engine
 						info.MoveNext();
 					} else if (info.GetToken().Class == TokenClass::CharCombo && info.GetToken().Content == L"{") {
 						info.MoveNext();
-						ns.Applications.Append(Format::InterfaceApplication());
-						auto & app = ns.Applications.LastElement();
-						app.Name = L"@UNNAMED" + string(uint32(info.GetUnnamed()), HexadecimalBase, 8);
+						auto & app = ns.AddApplication(L"@UNNAMED" + string(uint32(info.GetUnnamed()), HexadecimalBase, 8));
 						SHAPE_OBJECT(info, app.Root);
 						if (info.GetToken().Class != TokenClass::CharCombo || info.GetToken().Content != L'}') throw SyntaxException(DED(info), ErrorClass::UnexpectedLexem);
 						info.MoveNext();
@@ -1420,9 +1991,7 @@ namespace Engine
 						info.MoveNext();
 					} else if (info.GetToken().Class == TokenClass::CharCombo && info.GetToken().Content == L"{") {
 						info.MoveNext();
-						ns.Dialogs.Append(Format::InterfaceDialog());
-						auto & dlg = ns.Dialogs.LastElement();
-						dlg.Name = L"@UNNAMED" + string(uint32(info.GetUnnamed()), HexadecimalBase, 8);
+						auto & dlg = ns.AddDialog(L"@UNNAMED" + string(uint32(info.GetUnnamed()), HexadecimalBase, 8));
 						CONTROL_OBJECT(info, ns, dlg.Root, L"");
 						if (info.GetToken().Class != TokenClass::CharCombo || info.GetToken().Content != L'}') throw SyntaxException(DED(info), ErrorClass::UnexpectedLexem);
 						info.MoveNext();
@@ -1481,7 +2050,7 @@ namespace Engine
 			void CONTROL_OBJECT(DynamicInfo & info, DynamicInfo::PlatformContents & ns, Format::InterfaceControl & control, const string & parent_class)
 			{
 				if (info.GetToken().Class != TokenClass::Identifier) throw SyntaxException(DED(info), ErrorClass::UnexpectedLexem);
-				if (parent_class.Length() && warning_reporter && subordering) {
+				if (parent_class.Length() && info.Reporter && subordering) {
 					bool subord_failed = true;
 					for (auto & c : info.ClassData) if (c.Name == parent_class) {
 						if (c.AllowedChildren[info.GetToken().Content]) {
@@ -1491,7 +2060,7 @@ namespace Engine
 						}
 						break;
 					}
-					if (subord_failed) warning_reporter->ReportWarning(WarningClass::InvalidControlParent, info.GetToken().SourcePosition,
+					if (subord_failed) info.Reporter->ReportWarning(WarningClass::InvalidControlParent, info.GetToken().SourcePosition,
 						info.GetToken(1).SourcePosition - info.GetToken(0).SourcePosition, info.GetToken().Content + L"," + parent_class);
 				}
 				bool release = true;
@@ -1629,7 +2198,7 @@ namespace Engine
 						}
 						value.Cast(type_val);
 						value.Name = name;
-						info.Constants << value;
+						info.AddConstant(value);
 					} else if (info.GetToken().Content == L"resource") {
 						info.MoveNext();
 						if (info.GetToken().Class != TokenClass::Identifier) throw SyntaxException(DED(info), ErrorClass::UnexpectedLexem);
@@ -1641,12 +2210,12 @@ namespace Engine
 							int ID = info.GetColorID(name);
 							if (ID == -1) {
 								ID = info.Colors.Length() ? (info.Colors.LastElement().MachineIdentifier + 1) : 1;
-								info.Colors << DynamicInfo::ColorAlias{ name, ID };
+								info.AddColorAlias(DynamicInfo::ColorAlias{ name, ID });
 							}
 							info.MoveNext();
 							if (info.GetToken().Class == TokenClass::Identifier) {
 								platform = info.GetToken().Content;
-								if (!CheckPlatformName(platform) && warning_reporter) warning_reporter->ReportWarning(WarningClass::UnknownPlatformName,
+								if (!CheckPlatformName(platform) && info.Reporter) info.Reporter->ReportWarning(WarningClass::UnknownPlatformName,
 									info.GetToken().SourcePosition, info.GetToken(1).SourcePosition - info.GetToken(0).SourcePosition, platform);
 								info.MoveNext();
 							}
@@ -1659,7 +2228,7 @@ namespace Engine
 							Format::InterfaceColor obj = COLOR_OBJECT(info);
 							obj.ID = ID;
 							obj.Name = name;
-							cont.Colors << obj;
+							cont.AddColor(obj);
 						} else if (info.GetToken().Content == L"string") {
 							info.MoveNext();
 							if (info.GetToken().Class != TokenClass::Identifier) throw SyntaxException(DED(info), ErrorClass::UnexpectedLexem);
@@ -1678,7 +2247,7 @@ namespace Engine
 							if (info.GetToken().Class != TokenClass::CharCombo || info.GetToken().Content != L'}') throw SyntaxException(DED(info), ErrorClass::UnexpectedLexem);
 							info.MoveNext();
 							int ID = info.Strings.Length() ? (info.Strings.LastElement().MachineIdentifier + 1) : 1;
-							info.Strings << DynamicInfo::LocaleString{ name, ID, info.LastSet, ValueSet };
+							info.AddString(DynamicInfo::LocaleString{ name, ID, info.LastSet, ValueSet });
 						} else if (info.GetToken().Content == L"texture") {
 							info.MoveNext();
 							if (info.GetToken().Class != TokenClass::Identifier) throw SyntaxException(DED(info), ErrorClass::UnexpectedLexem);
@@ -1687,7 +2256,7 @@ namespace Engine
 							info.MoveNext();
 							if (info.GetToken().Class == TokenClass::Identifier) {
 								platform = info.GetToken().Content;
-								if (!CheckPlatformName(platform) && warning_reporter) warning_reporter->ReportWarning(WarningClass::UnknownPlatformName,
+								if (!CheckPlatformName(platform) && info.Reporter) info.Reporter->ReportWarning(WarningClass::UnknownPlatformName,
 									info.GetToken().SourcePosition, info.GetToken(1).SourcePosition - info.GetToken(0).SourcePosition, platform);
 								info.MoveNext();
 							}
@@ -1700,11 +2269,9 @@ namespace Engine
 							SafePointer<Codec::Image> Texture = TEXTURE_OBJECT(info);
 							if (Texture) {
 								Format::InterfaceTexture obj;
-								obj.ImageID = info.TextureID;
+								obj.ImageID = info.RegisterTexture(Texture);
 								obj.Name = name;
-								info.Output.Textures.Append(info.TextureID, Texture);
-								info.TextureID++;
-								cont.Textures << obj;
+								cont.AddTexture(obj);
 							}
 						} else if (info.GetToken().Content == L"font") {
 							info.MoveNext();
@@ -1714,7 +2281,7 @@ namespace Engine
 							info.MoveNext();
 							if (info.GetToken().Class == TokenClass::Identifier) {
 								platform = info.GetToken().Content;
-								if (!CheckPlatformName(platform) && warning_reporter) warning_reporter->ReportWarning(WarningClass::UnknownPlatformName,
+								if (!CheckPlatformName(platform) && info.Reporter) info.Reporter->ReportWarning(WarningClass::UnknownPlatformName,
 									info.GetToken().SourcePosition, info.GetToken(1).SourcePosition - info.GetToken(0).SourcePosition, platform);
 								info.MoveNext();
 							}
@@ -1724,9 +2291,7 @@ namespace Engine
 								info.Position--;
 								throw SyntaxException(DED(info), ErrorClass::ObjectRedifinition);
 							}
-							cont.Fonts.Append(Format::InterfaceFont());
-							auto & font = cont.Fonts.LastElement();
-							font.Name = name;
+							auto & font = cont.AddFont(name);
 							font.FontFace = Graphics::SystemSerifFont;
 							font.Height.Absolute = 0;
 							font.Height.Anchor = 0.0;
@@ -1749,7 +2314,7 @@ namespace Engine
 						info.MoveNext();
 						if (info.GetToken().Class == TokenClass::Identifier) {
 							platform = info.GetToken().Content;
-							if (!CheckPlatformName(platform) && warning_reporter) warning_reporter->ReportWarning(WarningClass::UnknownPlatformName,
+							if (!CheckPlatformName(platform) && info.Reporter) info.Reporter->ReportWarning(WarningClass::UnknownPlatformName,
 								info.GetToken().SourcePosition, info.GetToken(1).SourcePosition - info.GetToken(0).SourcePosition, platform);
 							info.MoveNext();
 						}
@@ -1759,9 +2324,7 @@ namespace Engine
 							info.Position--;
 							throw SyntaxException(DED(info), ErrorClass::ObjectRedifinition);
 						}
-						cont.Applications.Append(Format::InterfaceApplication());
-						auto & app = cont.Applications.LastElement();
-						app.Name = name;
+						auto & app = cont.AddApplication(name);
 						if (info.GetToken().Class != TokenClass::CharCombo || info.GetToken().Content != L'{') throw SyntaxException(DED(info), ErrorClass::UnexpectedLexem);
 						info.MoveNext();
 						SHAPE_OBJECT(info, app.Root);
@@ -1781,7 +2344,7 @@ namespace Engine
 						info.MoveNext();
 						if (info.GetToken().Class == TokenClass::Identifier) {
 							platform = info.GetToken().Content;
-							if (!CheckPlatformName(platform) && warning_reporter) warning_reporter->ReportWarning(WarningClass::UnknownPlatformName,
+							if (!CheckPlatformName(platform) && info.Reporter) info.Reporter->ReportWarning(WarningClass::UnknownPlatformName,
 								info.GetToken().SourcePosition, info.GetToken(1).SourcePosition - info.GetToken(0).SourcePosition, platform);
 							info.MoveNext();
 						}
@@ -1791,10 +2354,7 @@ namespace Engine
 							info.Position--;
 							throw SyntaxException(DED(info), ErrorClass::ObjectRedifinition);
 						}
-						cont.Styles.Append(Format::InterfaceDialog());
-						auto & stl = cont.Styles.LastElement();
-						stl.Name = name;
-						stl.Root.Class = cls;
+						auto & stl = cont.AddStyle(name, cls);
 						if (info.GetToken().Class != TokenClass::CharCombo || info.GetToken().Content != L'{') throw SyntaxException(DED(info), ErrorClass::UnexpectedLexem);
 						info.MoveNext();
 						STYLE_OBJECT(info, cont, stl);
@@ -1808,7 +2368,7 @@ namespace Engine
 						info.MoveNext();
 						if (info.GetToken().Class == TokenClass::Identifier) {
 							platform = info.GetToken().Content;
-							if (!CheckPlatformName(platform) && warning_reporter) warning_reporter->ReportWarning(WarningClass::UnknownPlatformName,
+							if (!CheckPlatformName(platform) && info.Reporter) info.Reporter->ReportWarning(WarningClass::UnknownPlatformName,
 								info.GetToken().SourcePosition, info.GetToken(1).SourcePosition - info.GetToken(0).SourcePosition, platform);
 							info.MoveNext();
 						}
@@ -1818,9 +2378,7 @@ namespace Engine
 							info.Position--;
 							throw SyntaxException(DED(info), ErrorClass::ObjectRedifinition);
 						}
-						cont.Dialogs.Append(Format::InterfaceDialog());
-						auto & dlg = cont.Dialogs.LastElement();
-						dlg.Name = name;
+						auto & dlg = cont.AddDialog(name);
 						if (info.GetToken().Class != TokenClass::CharCombo || info.GetToken().Content != L'{') throw SyntaxException(DED(info), ErrorClass::UnexpectedLexem);
 						info.MoveNext();
 						CONTROL_OBJECT(info, cont, dlg.Root, L"");
@@ -1830,12 +2388,226 @@ namespace Engine
 				}
 				if (info.GetToken().Class != TokenClass::EndOfStream) throw SyntaxException(DED(info), ErrorClass::UnexpectedLexem);
 			}
+			constexpr int AtlasPadding = 1;
+			constexpr int AtlasSpriteLimit = 128;
+			constexpr int AtlasSizeLimit = 2048;
+			struct AtlasSprite
+			{
+				int ImageID;
+				Codec::Frame * Frame;
+				int Atlas;
+				int Left;
+				int Top;
+			};
+			struct AtlasGroup
+			{
+				double Scale;
+				Array<int> Sprites;
+				AtlasGroup(void) : Sprites(0x40) {}
+			};
+			void MarkSetterTextures(Format::InterfaceControl & control, Volumes::Dictionary<string, int> & excluded)
+			{
+				for (int i = 0; i < control.StringsSetters.Length(); i++) excluded.Append(control.StringsSetters[i].Value, 1);
+				for (int i = 0; i < control.Children.Length(); i++) MarkSetterTextures(control.Children[i], excluded);
+			}
+			Format::InterfaceStringTemplate * GetShapeTexture(Format::InterfaceShape & shape)
+			{
+				if (shape.Class != L"Texture") return 0;
+				for (int i = 0; i < shape.StringValues.Length(); i++) if (shape.StringValues[i].Name == L"Texture") return &shape.StringValues[i];
+				return 0;
+			}
+			bool HasShapeSource(Format::InterfaceShape & shape)
+			{
+				for (int i = 0; i < shape.RectangleValues.Length(); i++) if (shape.RectangleValues[i].Name == L"Source") return true;
+				return false;
+			}
+			void MarkShapeTextures(Format::InterfaceShape & shape, Volumes::Dictionary<string, int> & excluded)
+			{
+				auto texture = GetShapeTexture(shape);
+				if (texture && !texture->Argument.Length() && HasShapeSource(shape)) excluded.Append(texture->Value, 1);
+				for (int i = 0; i < shape.Children.Length(); i++) MarkShapeTextures(shape.Children[i], excluded);
+			}
+			void RewriteShapeTextures(Format::InterfaceShape & shape, Volumes::Dictionary<string, int> & placement, Array<AtlasSprite> & sprites)
+			{
+				auto texture = GetShapeTexture(shape);
+				if (texture && !texture->Argument.Length()) {
+					auto index = placement[texture->Value];
+					if (index) {
+						auto & sprite = sprites[*index];
+						shape.RectangleValues.AppendNew();
+						auto & val = shape.RectangleValues.InnerArray.LastElement();
+						val.Name = L"Source";
+						for (int i = 0; i < 12; i++) val.Argument[i] = L"";
+						for (int i = 0; i < 8; i++) val.Scalable[i] = 0.0;
+						val.Absolute[0] = sprite.Left;
+						val.Absolute[1] = sprite.Top;
+						val.Absolute[2] = sprite.Left + sprite.Frame->GetWidth();
+						val.Absolute[3] = sprite.Top + sprite.Frame->GetHeight();
+					}
+				}
+				for (int i = 0; i < shape.Children.Length(); i++) RewriteShapeTextures(shape.Children[i], placement, sprites);
+			}
+			uint8 * GetFrameRow(Codec::Frame * frame, int y)
+			{
+				if (frame->GetScanOrigin() == Codec::ScanOrigin::BottomUp) y = frame->GetHeight() - 1 - y;
+				return frame->GetData() + intptr(y) * frame->GetScanLineLength();
+			}
+			void BlitSprite(Codec::Frame * atlas, const AtlasSprite & sprite)
+			{
+				int w = sprite.Frame->GetWidth(), h = sprite.Frame->GetHeight();
+				for (int y = -AtlasPadding; y < h + AtlasPadding; y++) {
+					auto src = GetFrameRow(sprite.Frame, min(max(y, 0), h - 1));
+					auto dest = GetFrameRow(atlas, sprite.Top + y) + (sprite.Left - AtlasPadding) * 4;
+					for (int x = 0; x < AtlasPadding; x++) { MemoryCopy(dest, src, 4); dest += 4; }
+					MemoryCopy(dest, src, w * 4);
+					dest += w * 4;
+					for (int x = 0; x < AtlasPadding; x++) { MemoryCopy(dest, src + (w - 1) * 4, 4); dest += 4; }
+				}
+			}
+			void BuildTextureAtlases(Format::InterfaceTemplateImage * image, TextureAtlasStatistics & stats)
+			{
+				stats.TexturesPacked = stats.TexturesSkipped = stats.AtlasCount = 0;
+				stats.SpriteArea = stats.AtlasArea = 0;
+				Volumes::Dictionary<string, int> excluded;
+				Volumes::Dictionary<string, int> defined;
+				Volumes::Dictionary<int, int> excluded_images;
+				for (int i = 0; i < image->Assets.Length(); i++) {
+					auto & asset = image->Assets[i];
+					for (int j = 0; j < asset.Dialogs.Length(); j++) MarkSetterTextures(asset.Dialogs[j].Root, excluded);
+					for (int j = 0; j < asset.Styles.Length(); j++) MarkSetterTextures(asset.Styles[j].Root, excluded);
+					for (int j = 0; j < asset.Applications.Length(); j++) MarkShapeTextures(asset.Applications[j].Root, excluded);
+					for (int j = 0; j < asset.Textures.Length(); j++) {
+						auto & name = asset.Textures[j].Name;
+						if (defined[name]) excluded.Append(name, 1); else defined.Append(name, 1);
+					}
+				}
+				// An image can only move into an atlas when every texture naming it is referenced by texture shapes alone.
+				Array<AtlasSprite> sprites(0x40);
+				Volumes::Dictionary<int, int> sprite_index;
+				int next_id = 1;
+				for (int i = 0; i < image->Assets.Length(); i++) for (int j = 0; j < image->Assets[i].Textures.Length(); j++) {
+					auto & texture = image->Assets[i].Textures[j];
+					next_id = max(next_id, texture.ImageID + 1);
+					if (excluded[texture.Name]) excluded_images.Append(texture.ImageID, 1);
+				}
+				for (int i = 0; i < image->Assets.Length(); i++) for (int j = 0; j < image->Assets[i].Textures.Length(); j++) {
+					auto & texture = image->Assets[i].Textures[j];
+					if (sprite_index[texture.ImageID] || excluded_images[texture.ImageID]) continue;
+					auto source = image->Textures[texture.ImageID];
+					bool eligible = source && (*source)->Frames.Length() == 1;
+					if (eligible) {
+						auto frame = (*source)->Frames.ElementAt(0);
+						eligible = frame->GetPixelFormat() == Codec::PixelFormat::R8G8B8A8 && frame->GetWidth() <= AtlasSpriteLimit && frame->GetHeight() <= AtlasSpriteLimit;
+					}
+					if (!eligible) {
+						excluded_images.Append(texture.ImageID, 1);
+						stats.TexturesSkipped++;
+						continue;
+					}
+					AtlasSprite sprite;
+					sprite.ImageID = texture.ImageID;
+					sprite.Frame = (*source)->Frames.ElementAt(0);
+					sprite.Atlas = -1;
+					sprite.Left = sprite.Top = 0;
+					sprite_index.Append(texture.ImageID, sprites.Length());
+					sprites << sprite;
+				}
+				Array<AtlasGroup> groups(0x10);
+				for (int i = 0; i < sprites.Length(); i++) {
+					int g = 0;
+					while (g < groups.Length() && groups[g].Scale != sprites[i].Frame->DpiUsage) g++;
+					if (g == groups.Length()) {
+						groups << AtlasGroup();
+						groups.LastElement().Scale = sprites[i].Frame->DpiUsage;
+					}
+					groups[g].Sprites << i;
+				}
+				Array<SafePointer<Codec::Frame> > atlases(0x10);
+				for (auto & group : groups) {
+					if (group.Sprites.Length() < 2) continue;
+					for (int i = 1; i < group.Sprites.Length(); i++) {
+						int j = i;
+						while (j && sprites[group.Sprites[j]].Frame->GetHeight() > sprites[group.Sprites[j - 1]].Frame->GetHeight()) {
+							swap(group.Sprites[j], group.Sprites[j - 1]);
+							j--;
+						}
+					}
+					int64 area = 0;
+					int widest = 0;
+					for (auto & i : group.Sprites) {
+						area += int64(sprites[i].Frame->GetWidth() + 2 * AtlasPadding) * (sprites[i].Frame->GetHeight() + 2 * AtlasPadding);
+						widest = max(widest, sprites[i].Frame->GetWidth() + 2 * AtlasPadding);
+					}
+					int width = 64;
+					while (width < AtlasSizeLimit && (width < widest || int64(width) * width < area)) width *= 2;
+					int first = 0;
+					while (first < group.Sprites.Length()) {
+						int x = 0, y = 0, shelf = 0, last = first;
+						while (last < group.Sprites.Length()) {
+							auto & sprite = sprites[group.Sprites[last]];
+							int w = sprite.Frame->GetWidth() + 2 * AtlasPadding, h = sprite.Frame->GetHeight() + 2 * AtlasPadding;
+							if (x + w > width) { x = 0; y += shelf; shelf = 0; }
+							if (y + h > AtlasSizeLimit) break;
+							sprite.Atlas = atlases.Length();
+							sprite.Left = x + AtlasPadding;
+							sprite.Top = y + AtlasPadding;
+							x += w;
+							shelf = max(shelf, h);
+							last++;
+						}
+						if (last - first < 2) {
+							for (int i = first; i < last; i++) sprites[group.Sprites[i]].Atlas = -1;
+							stats.TexturesSkipped += last - first;
+							first = last;
+							continue;
+						}
+						SafePointer<Codec::Frame> atlas = new Codec::Frame(width, y + shelf, -1, Codec::PixelFormat::R8G8B8A8, Codec::AlphaMode::Normal, Codec::ScanOrigin::BottomUp);
+						ZeroMemory(atlas->GetData(), intptr(atlas->GetScanLineLength()) * atlas->GetHeight());
+						atlas->DpiUsage = group.Scale;
+						for (int i = first; i < last; i++) {
+							auto & sprite = sprites[group.Sprites[i]];
+							BlitSprite(atlas, sprite);
+							stats.SpriteArea += int64(sprite.Frame->GetWidth()) * sprite.Frame->GetHeight();
+						}
+						stats.AtlasArea += int64(atlas->GetWidth()) * atlas->GetHeight();
+						stats.TexturesPacked += last - first;
+						atlases << atlas;
+						first = last;
+					}
+				}
+				for (auto & group : groups) if (group.Sprites.Length() < 2) stats.TexturesSkipped += group.Sprites.Length();
+				if (!atlases.Length()) return;
+				stats.AtlasCount = atlases.Length();
+				Array<int> atlas_ids(0x10);
+				for (auto & atlas : atlases) {
+					while (image->Textures[next_id]) next_id++;
+					SafePointer<Codec::Image> atlas_image = new Codec::Image;
+					atlas_image->Frames.Append(atlas);
+					image->Textures.Append(next_id, atlas_image);
+					atlas_ids << next_id;
+				}
+				Volumes::Dictionary<string, int> placement;
+				for (int i = 0; i < image->Assets.Length(); i++) for (int j = 0; j < image->Assets[i].Textures.Length(); j++) {
+					auto & texture = image->Assets[i].Textures[j];
+					auto index = sprite_index[texture.ImageID];
+					if (!index || sprites[*index].Atlas < 0) continue;
+					placement.Append(texture.Name, *index);
+					texture.ImageID = atlas_ids[sprites[*index].Atlas];
+				}
+				for (int i = 0; i < image->Assets.Length(); i++) for (int j = 0; j < image->Assets[i].Applications.Length(); j++) {
+					RewriteShapeTextures(image->Assets[i].Applications[j].Root, placement, sprites);
+				}
+				for (auto & sprite : sprites) if (sprite.Atlas >= 0) image->Textures.Remove(sprite.ImageID);
+			}
 			Format::InterfaceTemplateImage * CompileInterface(const string & main_uiml, bool as_style, int & error_position, int & error_length, ErrorClass & error, string & error_descr, const string & inc_path)
+			{
+				return CompileInterface(main_uiml, as_style, error_position, error_length, error, error_descr, inc_path, warning_reporter, 0);
+			}
+			Format::InterfaceTemplateImage * CompileInterface(const string & main_uiml, bool as_style, int & error_position, int & error_length, ErrorClass & error, string & error_descr, const string & inc_path, IWarningReporter * reporter, ICompilationCache * cache, Array<SourceDependency> * dependencies, bool prefetch)
 			{
 				try {
 					// STEP ONE. Loading and lexical analysis.
 					string master_source;
-					SafePointer< Array<Token> > source;
 					Spelling uiml_spelling;
 					uiml_spelling.BooleanFalseLiteral = L"false";
 					uiml_spelling.BooleanTrueLiteral = L"true";
@@ -1864,13 +2636,19 @@ namespace Engine
 					uiml_spelling.IsolatedChars << L'(';
 					uiml_spelling.IsolatedChars << L')';
 					uiml_spelling.IsolatedChars << L'=';
-					{
-						MacroInfo macro;
-						source = ParseSource(IO::ExpandPath(main_uiml), macro, inc_path, uiml_spelling, &master_source);
+					SafePointer<CompilationCache> local_cache;
+					auto compilation_cache = static_cast<CompilationCache *>(cache);
+					if (!compilation_cache) {
+						local_cache = new CompilationCache(L"");
+						compilation_cache = local_cache;
 					}
-					// STEP TWO. Syntax analysis and execution.
+					MacroInfo macro;
+					TokenStream source(IO::ExpandPath(main_uiml), macro, inc_path, uiml_spelling, compilation_cache, dependencies, &master_source);
+					// Prefetching spawns its own pool, so it is left out when the compilation itself runs on one.
+					if (prefetch) PrefetchImages(source, compilation_cache);
+					// STEP TWO. Syntax analysis and execution. Includes and macros are expanded as the tokens are consumed.
 					SafePointer<Format::InterfaceTemplateImage> image = new Format::InterfaceTemplateImage;
-					DynamicInfo dynamic(master_source, *source, *image);
+					DynamicInfo dynamic(master_source, source, *image, reporter, compilation_cache, dependencies);
 					DOCUMENT(dynamic);
 					// STEP THREE. Post-production
 					for (int i = 0; i < dynamic.GlobalLocaleSet.Length(); i++) {
@@ -1900,14 +2678,8 @@ namespace Engine
 						if (as_style) {
 							for (int j = 0; j < asset.Styles.Length(); j++) {
 								auto & stl = asset.Styles[j];
-								int def_index = -1;
-								for (int k = 0; k < dynamic.DefaultStyles.Length(); k++) {
-									if (dynamic.DefaultStyles[k].Style == stl.Name && dynamic.DefaultStyles[k].Class == stl.Root.Class) {
-										def_index = k;
-										break;
-									}
-								}
-								if (def_index >= 0) {
+								auto def_index = dynamic.DefaultStyleIndex[stl.Root.Class];
+								if (def_index && dynamic.DefaultStyles[*def_index].Style == stl.Name) {
 									asset.Dialogs << stl;
 									asset.Dialogs.InnerArray.LastElement().Name = L"@default:" + stl.Root.Class;
 								}
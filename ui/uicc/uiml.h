@@ -16,11 +16,32 @@ namespace Engine
 			public:
 				virtual void ReportWarning(WarningClass warning_class, int warning_pos, int warning_length, const string & warning_info) = 0;
 			};
+			class ICompilationCache : public Object
+			{
+			public:
+				virtual void Clear(void) = 0;
+			};
+			struct SourceDependency
+			{
+				string Path;
+				string Digest;
+			};
+			struct TextureAtlasStatistics
+			{
+				int TexturesPacked;
+				int TexturesSkipped;
+				int AtlasCount;
+				int64 SpriteArea;
+				int64 AtlasArea;
+			};
 			void SetWarningReporterCallback(IWarningReporter * callback);
 			IWarningReporter * GetWarningReporterCallback(void);
 			void SetSuborderingTable(Storage::RegistryNode * table);
 			Storage::RegistryNode * GetSuborderingTable(void);
+			ICompilationCache * CreateCompilationCache(const string & token_cache = L"");
 			Format::InterfaceTemplateImage * CompileInterface(const string & main_uiml, bool as_style, int & error_position, int & error_length, ErrorClass & error, string & error_descr, const string & inc_path = L"");
+			Format::InterfaceTemplateImage * CompileInterface(const string & main_uiml, bool as_style, int & error_position, int & error_length, ErrorClass & error, string & error_descr, const string & inc_path, IWarningReporter * reporter, ICompilationCache * cache, Array<SourceDependency> * dependencies = 0, bool prefetch = true);
+			void BuildTextureAtlases(Format::InterfaceTemplateImage * image, TextureAtlasStatistics & stats);
 		}
 	}
 }
\ No newline at end of file